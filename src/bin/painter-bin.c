@@ -34,8 +34,6 @@ Dali_Format format;
 
 Obdn_PrimitiveHandle prim;
 
-Obdn_Image brushAlpha;
-
 Obdn_Geometry paintGeo;
 
 Shiv_Renderer* renderer;
@@ -53,6 +51,10 @@ static bool spaceDown = false;
 
 static bool is2D;
 
+static Vec3  pivot = {0, 0, 0};
+static float mouseX; // 0 to 1, for picks
+static float mouseY;
+
 struct SceneMemEng {
     Obdn_Scene* scene;
     Obdn_Memory* mem;
@@ -99,15 +101,18 @@ static void loadAlphaImage(Hell_Grimoire* grim, void* data)
     const char* path = hell_GetArg(grim, 1);
     if (access(path, R_OK) == 0)
     {
-        if (brushAlpha.size != 0)
-        {
-            obdn_FreeImage(&brushAlpha);
-        }
+        Obdn_Image brushAlpha;
         obdn_LoadImage(
-            oMemory, path, 4, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT,
+            oMemory, path, 4, VK_FORMAT_B8G8R8A8_UNORM, 
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
             VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, VK_FILTER_LINEAR,
             VK_IMAGE_LAYOUT_GENERAL, false, OBDN_MEMORY_DEVICE_TYPE, &brushAlpha);
-        dali_SetBrushAlpha(brush, &brushAlpha);
+        Dali_BrushTipId tip = dali_AddBrushTip(engine, &brushAlpha);
+        obdn_FreeImage(&brushAlpha);
+        if (tip == DALI_BRUSH_TIP_NONE)
+            hell_Print("No room for another brush tip.\n");
+        else
+            dali_SetBrushTip(brush, tip);
     }
     else 
     {
@@ -142,6 +147,178 @@ setBrushColor(Hell_Grimoire* grim, void* pbrush)
     dali_SetBrushColor(brush, r, g, b);
 }
 
+// layer properties apply to the active layer
+static void
+setLayerOpacity(Hell_Grimoire* grim, void* pstack)
+{
+    Dali_LayerStack* stack = pstack;
+    dali_SetLayerOpacity(stack, dali_GetActiveLayerId(stack),
+                         atof(hell_GetArg(grim, 1)));
+}
+
+static void
+setLayerBlend(Hell_Grimoire* grim, void* pstack)
+{
+    Dali_LayerStack* stack = pstack;
+    const char* names[] = {"normal", "multiply", "screen",
+                           "overlay", "add", "softlight"};
+    const char* arg = hell_GetArg(grim, 1);
+    for (int i = 0; i < LEN(names); i++)
+    {
+        if (strcmp(arg, names[i]) == 0)
+        {
+            dali_SetLayerBlendMode(stack, dali_GetActiveLayerId(stack), i);
+            return;
+        }
+    }
+    hell_Print("Unknown blend mode %s\n", arg);
+}
+
+static void
+toggleLayerVisible(Hell_Grimoire* grim, void* pstack)
+{
+    Dali_LayerStack* stack = pstack;
+    const Dali_LayerId id = dali_GetActiveLayerId(stack);
+    dali_SetLayerVisible(stack, id, !dali_GetLayerVisible(stack, id));
+}
+
+static void
+createMaskLayer(Hell_Grimoire* grim, void* pstack)
+{
+    if (dali_CreateMaskLayer(pstack, atof(hell_GetArg(grim, 1)),
+                             atof(hell_GetArg(grim, 2)),
+                             atof(hell_GetArg(grim, 3))) == -1)
+        hell_Print("Can't create a mask layer: out of layers, or the "
+                   "texture isn't rgba8\n");
+}
+
+static void
+setLayerFill(Hell_Grimoire* grim, void* pstack)
+{
+    Dali_LayerStack* stack = pstack;
+    dali_SetLayerFill(stack, dali_GetActiveLayerId(stack),
+                      atof(hell_GetArg(grim, 1)), atof(hell_GetArg(grim, 2)),
+                      atof(hell_GetArg(grim, 3)));
+}
+
+static void
+groupLayers(Hell_Grimoire* grim, void* pstack)
+{
+    Dali_LayerStack* stack = pstack;
+    const Dali_LayerGroupId g = dali_GroupLayers(
+        stack, atoi(hell_GetArg(grim, 1)), atoi(hell_GetArg(grim, 2)));
+    if (g == DALI_LAYER_GROUP_NONE)
+        hell_Print("Could not group those layers\n");
+    else
+        hell_Print("Group %d\n", g);
+}
+
+static void
+setGroupOpacity(Hell_Grimoire* grim, void* pstack)
+{
+    Dali_LayerStack* stack = pstack;
+    dali_SetGroupOpacity(stack, atoi(hell_GetArg(grim, 1)),
+                         atof(hell_GetArg(grim, 2)));
+}
+
+static void
+fillLayer(Hell_Grimoire* grim, void* pstack)
+{
+    dali_FillLayer(pstack, atof(hell_GetArg(grim, 1)),
+                   atof(hell_GetArg(grim, 2)), atof(hell_GetArg(grim, 3)),
+                   atof(hell_GetArg(grim, 4)));
+}
+
+static void
+clearLayer(Hell_Grimoire* grim, void* pstack)
+{
+    dali_ClearLayer(pstack);
+}
+
+static void
+duplicateLayer(Hell_Grimoire* grim, void* pstack)
+{
+    dali_DuplicateLayer(pstack);
+}
+
+static void
+mergeLayerDown(Hell_Grimoire* grim, void* pstack)
+{
+    dali_MergeLayerDown(pstack);
+}
+
+static void
+flattenLayers(Hell_Grimoire* grim, void* pstack)
+{
+    dali_FlattenLayers(pstack);
+}
+
+static void
+deleteLayer(Hell_Grimoire* grim, void* pstack)
+{
+    dali_DeleteLayer(pstack);
+}
+
+static void
+moveLayer(Hell_Grimoire* grim, void* pstack)
+{
+    dali_MoveLayer(pstack, atoi(hell_GetArg(grim, 1)));
+}
+
+// layerbudget deviceMB hostMB [swap-file]
+static void
+setLayerBudget(Hell_Grimoire* grim, void* pstack)
+{
+    const VkDeviceSize mb = 1 << 20;
+    const char* path = hell_GetArgC(grim) > 3 ? hell_GetArg(grim, 3) : NULL;
+    dali_SetLayerBudget(pstack, atoi(hell_GetArg(grim, 1)) * mb,
+                        atoi(hell_GetArg(grim, 2)) * mb, path);
+}
+
+static void
+setLayerPacking(Hell_Grimoire* grim, void* pstack)
+{
+    dali_SetLayerPacking(pstack, atoi(hell_GetArg(grim, 1)));
+}
+
+static void
+checkpointLayers(Hell_Grimoire* grim, void* pstack)
+{
+    dali_CheckpointLayers(pstack);
+}
+
+static void
+recoverLayers(Hell_Grimoire* grim, void* pstack)
+{
+    dali_RecoverLayers(pstack, hell_GetArg(grim, 1));
+}
+
+static void
+declineRecovery(Hell_Grimoire* grim, void* pstack)
+{
+    dali_DeclineRecovery(pstack, hell_GetArg(grim, 1));
+}
+
+static void
+undoLayerOp(Hell_Grimoire* grim, void* pundo)
+{
+    dali_UndoLayerOp(pundo);
+}
+
+static void
+onPivotPick(const Dali_Pick* pick, void* data)
+{
+    if (pick->hit)
+        pivot = pick->pos;
+}
+
+static void
+onColorPick(const Dali_Pick* pick, void* data)
+{
+    if (pick->hit && format == DALI_FORMAT_R8G8B8A8_UNORM)
+        dali_SetBrushColor(brush, pick->color.x, pick->color.y, pick->color.z);
+}
+
 bool 
 handleKeyEvent(const Hell_Event* ev, void* data)
 {
@@ -193,6 +370,16 @@ handleKeyEvent(const Hell_Event* ev, void* data)
             dali_IncrementLayer(layerStack);
         }
     }
+    if (code == HELL_KEY_P) // pivot on the surface under the mouse
+    {
+        if (ev->type == HELL_EVENT_TYPE_KEYDOWN)
+            dali_RequestPick(engine, mouseX, mouseY, onPivotPick, NULL);
+    }
+    if (code == HELL_KEY_I) // eyedropper
+    {
+        if (ev->type == HELL_EVENT_TYPE_KEYDOWN)
+            dali_RequestPick(engine, mouseX, mouseY, onColorPick, NULL);
+    }
     return false;
 }
 
@@ -260,7 +447,6 @@ static bool
             break;
         }
     }
-    static Vec3 target = {0, 0, 0};
     if (is2D)
     {
         float dx = 0, dy = 0, dz = 0;
@@ -274,7 +460,7 @@ static bool
         obdn_SceneUpdateCamera_Pos(scene, dx, dy, dz);
     }
     else 
-        obdn_UpdateCamera_ArcBall(scene, &target, windowWidth, windowHeight, 0.1,
+        obdn_UpdateCamera_ArcBall(scene, &pivot, windowWidth, windowHeight, 0.1,
                               xprev, mx, yprev, my, pan, tumble, zoom, false);
     xprev = mx;
     yprev = my;
@@ -286,6 +472,11 @@ handlePaintEvent(const Hell_Event* ev, void* data)
 {
     float mx = (float)ev->data.winData.data.mouseData.x / windowWidth;
     float my = (float)ev->data.winData.data.mouseData.y / windowHeight;
+    if (ev->type != HELL_EVENT_TYPE_STYLUS)
+    {
+        mouseX = mx;
+        mouseY = my;
+    }
     if (ev->type == HELL_EVENT_TYPE_MOUSEDOWN) 
     {
         dali_SetBrushActive(brush);
@@ -351,7 +542,9 @@ daliFrame(void)
 {
     dali_UpdateUndo(undoManager, layerStack);
 
-    obdn_WaitForFence(obdn_GetDevice(oInstance), &paintCommand.fence);
+    // dali_Paint waits on the fence too, so it's reset only at submission
+    vkWaitForFences(obdn_GetDevice(oInstance), 1, &paintCommand.fence, VK_TRUE,
+                    UINT64_MAX);
 
     VkFence                 fence = VK_NULL_HANDLE;
     const Obdn_Framebuffer* fb =
@@ -360,7 +553,7 @@ daliFrame(void)
     VkSemaphore undoWaitSemaphore = VK_NULL_HANDLE;
     obdn_ResetCommand(&paintCommand);
     obdn_BeginCommandBuffer(paintCommand.buffer);
-    undoWaitSemaphore = dali_Paint(engine, scene, brush, layerStack, undoManager, paintCommand.buffer);
+    undoWaitSemaphore = dali_Paint(engine, scene, brush, layerStack, undoManager, paintCommand.buffer, paintCommand.fence);
     obdn_EndCommandBuffer(paintCommand.buffer);
 
     obdn_ResetCommand(&renderCommand);
@@ -394,6 +587,7 @@ daliFrame(void)
         .pCommandBuffers = &renderCommand.buffer,
     };
     VkSubmitInfo submitinfos[] = {paintSubmit, renderSubmit};
+    vkResetFences(obdn_GetDevice(oInstance), 1, &paintCommand.fence);
     obdn_SubmitGraphicsCommands(oInstance, 0, LEN(submitinfos), submitinfos, paintCommand.fence);
     VkSemaphore waitSemas[] = {acquireSemaphore, renderCommand.semaphore};
     obdn_PresentFrame(swapchain, LEN(waitSemas), waitSemas);
@@ -456,7 +650,7 @@ painterMain(const char* modelpath, bool maskMode, bool twoDMode)
     brush       = dali_AllocBrush();
     undoManager = dali_AllocUndo();
 
-    u64 texSize = DALI_TEXSIZE(4096, 1, 4);
+    u64 texSize = DALI_TEXSIZE(4096, dali_GetFormatTexelSize(format), 1);
     dali_CreateUndoManager(oMemory, texSize, 1, 16, undoManager);
     dali_CreateBrush(grimoire, brush);
     dali_SetBrushRadius(brush, 0.01);
@@ -511,6 +705,26 @@ painterMain(const char* modelpath, bool maskMode, bool twoDMode)
     hell_AddCommand(grimoire, "loadalpha", loadAlphaImage, brush);
     hell_AddCommand(grimoire, "createengine", createEngine, NULL);
     hell_AddCommand(grimoire, "destroyengine", destroyEngine, NULL);
+    hell_AddCommand(grimoire, "layeropacity", setLayerOpacity, layerStack);
+    hell_AddCommand(grimoire, "layerblend", setLayerBlend, layerStack);
+    hell_AddCommand(grimoire, "layervis", toggleLayerVisible, layerStack);
+    hell_AddCommand(grimoire, "group", groupLayers, layerStack);
+    hell_AddCommand(grimoire, "masklayer", createMaskLayer, layerStack);
+    hell_AddCommand(grimoire, "layerfill", setLayerFill, layerStack);
+    hell_AddCommand(grimoire, "groupopacity", setGroupOpacity, layerStack);
+    hell_AddCommand(grimoire, "filllayer", fillLayer, layerStack);
+    hell_AddCommand(grimoire, "clearlayer", clearLayer, layerStack);
+    hell_AddCommand(grimoire, "duplayer", duplicateLayer, layerStack);
+    hell_AddCommand(grimoire, "mergedown", mergeLayerDown, layerStack);
+    hell_AddCommand(grimoire, "flatten", flattenLayers, layerStack);
+    hell_AddCommand(grimoire, "undolayerop", undoLayerOp, undoManager);
+    hell_AddCommand(grimoire, "deletelayer", deleteLayer, layerStack);
+    hell_AddCommand(grimoire, "movelayer", moveLayer, layerStack);
+    hell_AddCommand(grimoire, "layerbudget", setLayerBudget, layerStack);
+    hell_AddCommand(grimoire, "checkpoint", checkpointLayers, layerStack);
+    hell_AddCommand(grimoire, "layerpack", setLayerPacking, layerStack);
+    hell_AddCommand(grimoire, "recoverlayers", recoverLayers, layerStack);
+    hell_AddCommand(grimoire, "declinerecovery", declineRecovery, layerStack);
 
     hell_Subscribe(eventQueue, HELL_EVENT_MASK_POINTER_BIT,
                    hell_GetWindowID(window), handleMouseEvent, NULL);
@@ -2,17 +2,55 @@
 #define DALI_BRUSH_H
 
 #include <coal/coal.h>
+#include "layer.h"
 
 typedef struct Dali_Brush Dali_Brush;
-typedef struct Obdn_Image Obdn_Image;
+
+// tips are added to the engine's library with dali_AddBrushTip. 
+// tip 0 is always the default, fully opaque tip.
+typedef uint32_t Dali_BrushTipId;
+
+#define DALI_MAX_BRUSH_TIPS 16
+#define DALI_BRUSH_TIP_NONE ((Dali_BrushTipId)-1)
 
 typedef struct Hell_Grimoire Hell_Grimoire;
 
 typedef enum {
     DALI_PAINT_MODE_OVER,
-    DALI_PAINT_MODE_ERASE
+    DALI_PAINT_MODE_ERASE,
+    // these read the active layer around each hit instead of using the 
+    // brush color. they need a four channel engine format; a coverage 
+    // engine keeps its previous mode.
+    DALI_PAINT_MODE_SMUDGE,
+    DALI_PAINT_MODE_BLUR,
+    DALI_PAINT_MODE_SHARPEN,
+    DALI_PAINT_MODE_CLONE
 } Dali_PaintMode;
 
+// how the clone offset is interpreted. screen offsets are in the same 
+// 0 to 1 units as the brush position and are traced onto the surface, 
+// uv offsets are added to the uv under each ray.
+typedef enum {
+    DALI_CLONE_SPACE_SCREEN,
+    DALI_CLONE_SPACE_UV
+} Dali_CloneSpace;
+
+typedef enum {
+    DALI_AXIS_X,
+    DALI_AXIS_Y,
+    DALI_AXIS_Z
+} Dali_Axis;
+
+#define DALI_MIRROR_X_BIT (1 << DALI_AXIS_X)
+#define DALI_MIRROR_Y_BIT (1 << DALI_AXIS_Y)
+#define DALI_MIRROR_Z_BIT (1 << DALI_AXIS_Z)
+
+// a dab and all its mirrored and radial copies
+#define DALI_MAX_SYMMETRY_COPIES 32
+
+// clone from whichever layer is active
+#define DALI_CLONE_LAYER_ACTIVE ((Dali_LayerId)-1)
+
 Dali_Brush* dali_AllocBrush(void);
 
 void dali_CreateBrush(Hell_Grimoire* grim /* optional */, Dali_Brush *brush);
@@ -26,7 +64,20 @@ void dali_SetBrushFalloff(Dali_Brush* brush, float f);
 void dali_SetBrushMode(Dali_Brush* brush, Dali_PaintMode mode);
 Dali_PaintMode dali_GetBrushPaintMode(const Dali_Brush* brush);
 void dali_BrushClearDirt(Dali_Brush* brush);
-void dali_SetBrushAlpha(Dali_Brush* brush, Obdn_Image* alpha);
+void dali_SetBrushTip(Dali_Brush* brush, Dali_BrushTipId tip);
+
+// each dab picks a random tip from [first, first + count)
+void dali_SetBrushTipSet(Dali_Brush* brush, Dali_BrushTipId first, uint32_t count);
+
+// the clone brush copies from (dab position + offset) on the given layer
+void dali_SetBrushCloneSource(Dali_Brush* brush, Dali_CloneSpace space, float dx, float dy);
+void dali_SetBrushCloneLayer(Dali_Brush* brush, Dali_LayerId layer);
+
+// symmetry is about the prim's object space origin. every dab is 
+// mirrored across each plane in mirrors (a mask of DALI_MIRROR_*_BIT) 
+// and repeated radialCount times around axis. radialCount 1 is off.
+void dali_SetBrushMirror(Dali_Brush* brush, uint32_t mirrors);
+void dali_SetBrushRadialSymmetry(Dali_Brush* brush, Dali_Axis axis, uint32_t radialCount);
 
 void dali_SetBrushSpacing(Dali_Brush* brush, float spacing);
 
@@ -14,11 +14,33 @@
 typedef struct Dali_Engine Dali_Engine;
 typedef Obdn_Image Obdn_Image;
 
+// color formats paint the brush color. one channel formats paint coverage.
 typedef enum Dali_Format {
     DALI_FORMAT_R8G8B8A8_UNORM,
     DALI_FORMAT_R32_SFLOAT,
+    DALI_FORMAT_R16G16B16A16_SFLOAT, // hdr color
+    DALI_FORMAT_R8_UNORM,            // compact masks
+    DALI_FORMAT_R16_UNORM,           // height
+    DALI_FORMAT_R32G32B32A32_SFLOAT, // bake data
 } Dali_Format;
 
+// picks that can wait for one submission. must match MAX_PICKS in pick.glsl
+#define DALI_MAX_PICKS 16
+
+// what lies under a screen position. pos and normal are in world space. 
+// color is the composited texture at uv; r32 textures keep coverage in r.
+typedef struct Dali_Pick {
+    float x; // where it was requested
+    float y;
+    bool  hit;
+    Vec3  pos;
+    Vec3  normal;
+    Vec2  uv;
+    Vec4  color;
+} Dali_Pick;
+
+typedef void (*Dali_PickFn)(const Dali_Pick* pick, void* data);
+
 typedef enum Dali_EngineDirt {
     DALI_PRIM_CHANGED_BIT        = 1 << 0,
     DALI_PRIM_ADDED_BIT          = 1 << 1,
@@ -31,9 +53,16 @@ void dali_CreateEngine(const Obdn_Instance* instance, Obdn_Memory* memory,
                           Obdn_Scene* scene, const Dali_Brush* brush,
                           const uint32_t texSize, Dali_Format textureFormat,
                           Hell_Grimoire* grimoire, Dali_Engine* engine);
+// records the frame's painting into cmdbuf. fence is the one cmdbuf will 
+// be submitted with; the next call waits on it before touching anything 
+// this frame's work reads or writes back, so it mustn't be reset until 
+// just before that submission. fence was added to the signature; callers 
+// that have none pass VK_NULL_HANDLE and the next call waits for the 
+// device to go idle instead, as before.
 VkSemaphore dali_Paint(Dali_Engine* engine, const Obdn_Scene* scene,
                        const Dali_Brush* brush, Dali_LayerStack* stack,
-                       Dali_UndoManager* um, VkCommandBuffer cmdbuf);
+                       Dali_UndoManager* um, VkCommandBuffer cmdbuf,
+                       VkFence fence);
 
 void dali_DestroyEngine(Dali_Engine* engine, Obdn_Scene* scene);
 Obdn_MaterialHandle dali_GetPaintMaterial(Dali_Engine* engine);
@@ -41,6 +70,9 @@ Obdn_MaterialHandle dali_GetPaintMaterial(Dali_Engine* engine);
 void dali_SetActivePrim(Dali_Engine* engine, Obdn_PrimitiveHandle prim, Dali_EngineDirt mask);
 Obdn_PrimitiveHandle dali_GetActivePrim(Dali_Engine* engine);
 
+// size layer, undo and staging buffers with this
+uint32_t dali_GetFormatTexelSize(Dali_Format format);
+
 Dali_Engine* dali_AllocEngine(void);
 
 void dali_EngineDestroyImagesAndDependents(Dali_Engine* engine, Obdn_Scene* scene);
@@ -49,7 +81,30 @@ void dali_EngineCreateImagesAndDependents(Dali_Engine* engine, Obdn_Scene* scene
 
 void dali_SetRayWidth(Dali_Engine* engine, u32 width);
 
+// gpu time in ms the dabs of one frame should take. dabs over the budget 
+// wait for later frames. 0 draws every dab as soon as it's made.
+void dali_SetFrameBudget(Dali_Engine* engine, float ms);
+
+// while the brush rests, its dab is traced raysPerFrame at a time over 
+// the following frames and laid down once it's complete. 0 traces every 
+// dab whole.
+void dali_SetProgressiveRays(Dali_Engine* engine, u32 raysPerFrame);
+
 Obdn_Image* 
 dali_GetTextureImage(Dali_Engine*);
 
+// traces a ray through x, y (0 to 1, like the brush position) with the 
+// next paint submission. fn is called from a later dali_Paint, once the 
+// result is back, so nothing waits on the gpu. returns false when 
+// DALI_MAX_PICKS are already waiting.
+bool dali_RequestPick(Dali_Engine*, float x, float y, Dali_PickFn fn,
+                      void* data);
+
+// copies alpha into the engine's brush tip library, building its mip chain.
+// alpha must be created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT and may be 
+// freed as soon as this returns. DALI_BRUSH_TIP_NONE once the library 
+// holds DALI_MAX_BRUSH_TIPS.
+Dali_BrushTipId
+dali_AddBrushTip(Dali_Engine*, const Obdn_Image* alpha);
+
 #endif /* end of include guard: PAINT_H */
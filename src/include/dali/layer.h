@@ -4,8 +4,21 @@
 #include <obsidian/memory.h>
 
 typedef uint16_t Dali_LayerId;
+typedef uint16_t Dali_LayerGroupId;
+
+#define DALI_LAYER_GROUP_NONE ((Dali_LayerGroupId)0xFFFF)
 
 typedef struct Dali_Layer Dali_Layer;
+
+// how a layer is laid over the layers beneath it
+typedef enum Dali_BlendMode {
+    DALI_BLEND_MODE_NORMAL,
+    DALI_BLEND_MODE_MULTIPLY,
+    DALI_BLEND_MODE_SCREEN,
+    DALI_BLEND_MODE_OVERLAY,
+    DALI_BLEND_MODE_ADD,
+    DALI_BLEND_MODE_SOFT_LIGHT,
+} Dali_BlendMode;
 typedef struct Dali_LayerStack Dali_LayerStack;
 
 // returns number of layer or -1 on failure
@@ -21,8 +34,98 @@ bool        dali_DecrementLayer(Dali_LayerStack*);
 // returns address to the layer data
 uint8_t*    dali_CopyTextureToLayer(Dali_LayerStack*, const Dali_LayerId id, const void* data, uint32_t w, uint32_t h, VkFormat format);
 void dali_LayerStackClearDirt(Dali_LayerStack* layerStack);
+
+// applied when the stack is composited; the layer's pixels are untouched. 
+// while painting, layers above the active one are flattened ahead of time 
+// when they all blend normally. otherwise they're blended over the rest 
+// one by one every frame, which costs more.
+void           dali_SetLayerOpacity(Dali_LayerStack*, Dali_LayerId id, float opacity);
+void           dali_SetLayerVisible(Dali_LayerStack*, Dali_LayerId id, bool visible);
+void           dali_SetLayerBlendMode(Dali_LayerStack*, Dali_LayerId id, Dali_BlendMode mode);
+float          dali_GetLayerOpacity(const Dali_LayerStack*, Dali_LayerId id);
+bool           dali_GetLayerVisible(const Dali_LayerStack*, Dali_LayerId id);
+Dali_BlendMode dali_GetLayerBlendMode(const Dali_LayerStack*, Dali_LayerId id);
+
+// groups the layers [first, end) under a new group, nested in the 
+// smallest group that holds them all. fails with DALI_LAYER_GROUP_NONE if 
+// the range would split an existing group. a group is flattened into a 
+// cached image, rebuilt only when something under it changes. groups 
+// holding the active layer are passed through while it's painted if that 
+// looks the same: normal, at full opacity, over contents that all blend 
+// normally. any other is flattened around the active layer every frame.
+Dali_LayerGroupId dali_GroupLayers(Dali_LayerStack*, Dali_LayerId first, Dali_LayerId end);
+Dali_LayerGroupId dali_GetLayerGroup(const Dali_LayerStack*, Dali_LayerId id);
+Dali_LayerGroupId dali_GetGroupParent(const Dali_LayerStack*, Dali_LayerGroupId group);
+void              dali_SetGroupOpacity(Dali_LayerStack*, Dali_LayerGroupId group, float opacity);
+void              dali_SetGroupVisible(Dali_LayerStack*, Dali_LayerGroupId group, bool visible);
+void              dali_SetGroupBlendMode(Dali_LayerStack*, Dali_LayerGroupId group, Dali_BlendMode mode);
 void dali_LayerBackup(Dali_LayerStack* layerStack);
 
+// a fill color plus an 8-bit mask, packed four to a layer's worth of 
+// memory. only for stacks of rgba8 layers, so it fails before the engine 
+// has synced the stack once. returns -1 on failure.
+int  dali_CreateMaskLayer(Dali_LayerStack*, float r, float g, float b);
+bool dali_IsMaskLayer(const Dali_LayerStack*, Dali_LayerId id);
+void dali_SetLayerFill(Dali_LayerStack*, Dali_LayerId id, float r, float g, float b);
+
+// whole-layer edits, queued and run on the gpu at the next paint without 
+// reading layers back. clear and fill go into the active layer's undo 
+// history like a stroke; the others are taken back with dali_UndoLayerOp. 
+// filling a mask layer sets its fill color and its mask to a.
+void dali_ClearLayer(Dali_LayerStack*);
+void dali_FillLayer(Dali_LayerStack*, float r, float g, float b, float a);
+// the copy goes on top of the stack and becomes active
+void dali_DuplicateLayer(Dali_LayerStack*);
+// lays the active layer over the one below with its blend and opacity and 
+// removes it. the one below becomes active; ids above shift down by one.
+void dali_MergeLayerDown(Dali_LayerStack*);
+// composites the stack into layer 0 and removes the rest along with every 
+// group. layer 0 is reset to plain normal blending.
+void dali_FlattenLayers(Dali_LayerStack*);
+// removes the active layer, handing its memory back. the one below 
+// becomes active. ids above it shift down by one.
+void dali_DeleteLayer(Dali_LayerStack*);
+// moves the active layer to position to, renumbering the layers between. 
+// it joins whatever group it lands inside.
+void dali_MoveLayer(Dali_LayerStack*, Dali_LayerId to);
+
+// layers and mask sets take their memory from a couple of spare buffers, 
+// so creating one doesn't allocate. this does one step of refilling them, 
+// zeroing a recycled spare or allocating a new one. dali_EndFrame calls it.
+void dali_TopUpLayerPool(Dali_LayerStack*);
+
+// keeps at most deviceBytes of layer pixels in device memory and hostBytes 
+// in host memory, moving layers between them and the swap file at 
+// swapPath by how recently they were used. by default every layer stays 
+// in host memory. without a swap file the host budget can't be met. mask 
+// layers, group caches and undo history stay in host memory. returns 
+// false if the swap file can't be opened, or if it holds a crashed 
+// session's layers not yet taken back with dali_RecoverLayers or given up 
+// with dali_DeclineRecovery.
+// the swap file is memory mapped, so with a small host budget layers live 
+// in the os page cache and only the few in use hold host buffers. it's 
+// deleted when the stack is destroyed.
+bool dali_SetLayerBudget(Dali_LayerStack*, VkDeviceSize deviceBytes, VkDeviceSize hostBytes, const char* swapPath);
+
+// host layers left unused for idleSeconds are packed losslessly into the 
+// heap, a few tiles a frame, and unpacked when they're next needed. flat 
+// tiles and smooth rows pack best, so masks and sparse strokes shrink the 
+// most. 0, the default, turns it off.
+void dali_SetLayerPacking(Dali_LayerStack*, uint32_t idleSeconds);
+
+// writes every layer to the swap file at the end of the next frame, so a 
+// crash loses nothing before it. layers swapped out are already there.
+void dali_CheckpointLayers(Dali_LayerStack*);
+
+// adds the layers a crashed session left in the swap file at swapPath on 
+// top of the stack and makes the first of them active. afterwards the 
+// path can be set as this stack's swap file. returns how many came back, 
+// or -1 if the file isn't a swap file for layers of this size.
+int  dali_RecoverLayers(Dali_LayerStack*, const char* swapPath);
+// gives up on the layers in the swap file at swapPath, letting 
+// dali_SetLayerBudget write over it
+void dali_DeclineRecovery(Dali_LayerStack*, const char* swapPath);
+
 Dali_LayerStack* dali_AllocLayerStack(void);
 
 #endif /* end of include guard: LAYER_H */
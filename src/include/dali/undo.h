@@ -21,6 +21,9 @@ Dali_UndoManager* dali_AllocUndo(void);
 void dali_UpdateUndo(Dali_UndoManager* undo, Dali_LayerStack* layerStack);
 
 void dali_Undo(Dali_UndoManager* undo);
+// takes back the last duplicate, merge or flatten. strokes and layer ops 
+// have separate histories.
+void dali_UndoLayerOp(Dali_UndoManager* undo);
 void dali_UndoClearDirt(Dali_UndoManager* undo);
 
 #endif /* end of include guard: UNDO_H */
@@ -4,6 +4,7 @@
 #include "private.h"
 #include <stdlib.h>
 #include <math.h>
+#include <hell/minmax.h>
 
 
 static void setBrushPosCmd(const Hell_Grimoire* grim, void* brushptr)
@@ -70,6 +71,93 @@ static void setBrushAngleCmd(const Hell_Grimoire* grim, void* brushptr)
     dali_SetBrushAngle(brush, angle);
 }
 
+static void setBrushTipCmd(const Hell_Grimoire* grim, void* brushptr)
+{
+    Dali_Brush* brush = brushptr;
+    int first = atoi(hell_GetArg(grim, 1));
+    int count = atoi(hell_GetArg(grim, 2));
+    if (first < 0 || count < 0 || first + MAX(count, 1) > DALI_MAX_BRUSH_TIPS)
+    {
+        hell_Print("Bad value\n");
+        return;
+    }
+    dali_SetBrushTipSet(brush, first, MAX(count, 1));
+}
+
+static void setBrushModeCmd(const Hell_Grimoire* grim, void* brushptr)
+{
+    Dali_Brush* brush = brushptr;
+    const char* mode = hell_GetArg(grim, 1);
+    if      (strcmp(mode, "over") == 0)    dali_SetBrushMode(brush, PAINT_MODE_OVER);
+    else if (strcmp(mode, "erase") == 0)   dali_SetBrushMode(brush, PAINT_MODE_ERASE);
+    else if (strcmp(mode, "smudge") == 0)  dali_SetBrushMode(brush, PAINT_MODE_SMUDGE);
+    else if (strcmp(mode, "blur") == 0)    dali_SetBrushMode(brush, PAINT_MODE_BLUR);
+    else if (strcmp(mode, "sharpen") == 0) dali_SetBrushMode(brush, PAINT_MODE_SHARPEN);
+    else if (strcmp(mode, "clone") == 0)   dali_SetBrushMode(brush, PAINT_MODE_CLONE);
+    else hell_Print("Modes: over erase smudge blur sharpen clone\n");
+}
+
+static void setBrushCloneCmd(const Hell_Grimoire* grim, void* brushptr)
+{
+    Dali_Brush* brush = brushptr;
+    const char* space = hell_GetArg(grim, 1);
+    float dx = atof(hell_GetArg(grim, 2));
+    float dy = atof(hell_GetArg(grim, 3));
+    if      (strcmp(space, "screen") == 0) dali_SetBrushCloneSource(brush, DALI_CLONE_SPACE_SCREEN, dx, dy);
+    else if (strcmp(space, "uv") == 0)     dali_SetBrushCloneSource(brush, DALI_CLONE_SPACE_UV, dx, dy);
+    else hell_Print("Usage: brushclone screen|uv dx dy\n");
+}
+
+static void setBrushCloneLayerCmd(const Hell_Grimoire* grim, void* brushptr)
+{
+    Dali_Brush* brush = brushptr;
+    const char* layer = hell_GetArg(grim, 1);
+    if (strcmp(layer, "active") == 0)
+        dali_SetBrushCloneLayer(brush, DALI_CLONE_LAYER_ACTIVE);
+    else
+        dali_SetBrushCloneLayer(brush, atoi(layer));
+}
+
+static void setBrushMirrorCmd(const Hell_Grimoire* grim, void* brushptr)
+{
+    Dali_Brush* brush = brushptr;
+    const char* axes = hell_GetArg(grim, 1);
+    uint32_t mirrors = 0;
+    for (const char* c = axes; *c; c++)
+    {
+        switch (*c)
+        {
+        case 'x': mirrors |= DALI_MIRROR_X_BIT; break;
+        case 'y': mirrors |= DALI_MIRROR_Y_BIT; break;
+        case 'z': mirrors |= DALI_MIRROR_Z_BIT; break;
+        default: break; // "none" or anything else clears
+        }
+    }
+    dali_SetBrushMirror(brush, mirrors);
+}
+
+static void setBrushRadialCmd(const Hell_Grimoire* grim, void* brushptr)
+{
+    Dali_Brush* brush = brushptr;
+    const char* axis = hell_GetArg(grim, 1);
+    int count = atoi(hell_GetArg(grim, 2));
+    Dali_Axis a;
+    if      (strcmp(axis, "x") == 0) a = DALI_AXIS_X;
+    else if (strcmp(axis, "y") == 0) a = DALI_AXIS_Y;
+    else if (strcmp(axis, "z") == 0) a = DALI_AXIS_Z;
+    else
+    {
+        hell_Print("Usage: brushradial x|y|z count\n");
+        return;
+    }
+    if (count < 1 || count > DALI_MAX_SYMMETRY_COPIES)
+    {
+        hell_Print("Bad value\n");
+        return;
+    }
+    dali_SetBrushRadialSymmetry(brush, a, count);
+}
+
 static void setBrushAngleVariationCmd(const Hell_Grimoire* grim, void* brushptr)
 {
     Dali_Brush* brush = brushptr;
@@ -95,6 +183,12 @@ void dali_CreateBrush(Hell_Grimoire* grim, Dali_Brush *brush)
     brush->spacing = 0.001;
     brush->angle = 0.0;
     brush->angleVariation = M_PI_2;
+    brush->tip = 0;
+    brush->tipSetSize = 1;
+    brush->cloneSpace = DALI_CLONE_SPACE_SCREEN;
+    brush->cloneLayer = DALI_CLONE_LAYER_ACTIVE;
+    brush->radialAxis = DALI_AXIS_Y;
+    brush->radialCount = 1;
     brush->dirt = -1;
 
     if (grim)
@@ -109,6 +203,12 @@ void dali_CreateBrush(Hell_Grimoire* grim, Dali_Brush *brush)
         hell_AddCommand(grim, "brushspacing", setBrushSpacingCmd, brush);
         hell_AddCommand(grim, "brushangle", setBrushAngleCmd, brush);
         hell_AddCommand(grim, "brushangvar", setBrushAngleVariationCmd, brush);
+        hell_AddCommand(grim, "brushtip", setBrushTipCmd, brush);
+        hell_AddCommand(grim, "brushmode", setBrushModeCmd, brush);
+        hell_AddCommand(grim, "brushclone", setBrushCloneCmd, brush);
+        hell_AddCommand(grim, "brushclonelayer", setBrushCloneLayerCmd, brush);
+        hell_AddCommand(grim, "brushmirror", setBrushMirrorCmd, brush);
+        hell_AddCommand(grim, "brushradial", setBrushRadialCmd, brush);
     }
 }
 
@@ -181,10 +281,58 @@ dali_GetBrushPos(Dali_Brush* brush)
     return pos;
 }
 
-void dali_SetBrushAlpha(Dali_Brush* brush, Obdn_Image* alpha)
+void dali_SetBrushTip(Dali_Brush* brush, Dali_BrushTipId tip)
+{
+    dali_SetBrushTipSet(brush, tip, 1);
+}
+
+void dali_SetBrushTipSet(Dali_Brush* brush, Dali_BrushTipId first, uint32_t count)
 {
-    brush->alphaImg = alpha;
-    brush->dirt |= BRUSH_ALPHA_BIT;
+    assert(count > 0);
+    assert(first + count <= DALI_MAX_BRUSH_TIPS);
+    brush->tip = first;
+    brush->tipSetSize = count;
+    brush->dirt |= BRUSH_GENERAL_BIT;
+}
+
+void dali_SetBrushCloneSource(Dali_Brush* brush, Dali_CloneSpace space, float dx, float dy)
+{
+    brush->cloneSpace = space;
+    brush->cloneOffsetX = dx;
+    brush->cloneOffsetY = dy;
+    brush->dirt |= BRUSH_GENERAL_BIT;
+}
+
+void dali_SetBrushCloneLayer(Dali_Brush* brush, Dali_LayerId layer)
+{
+    brush->cloneLayer = layer;
+    brush->dirt |= BRUSH_GENERAL_BIT;
+}
+
+static uint32_t
+symmetryCopies(uint32_t mirrors, uint32_t radialCount)
+{
+    uint32_t copies = radialCount;
+    for (int axis = DALI_AXIS_X; axis <= DALI_AXIS_Z; axis++)
+        if (mirrors & (1 << axis))
+            copies *= 2;
+    return copies;
+}
+
+void dali_SetBrushMirror(Dali_Brush* brush, uint32_t mirrors)
+{
+    assert(symmetryCopies(mirrors, brush->radialCount) <= DALI_MAX_SYMMETRY_COPIES);
+    brush->mirrors = mirrors;
+    brush->dirt |= BRUSH_GENERAL_BIT;
+}
+
+void dali_SetBrushRadialSymmetry(Dali_Brush* brush, Dali_Axis axis, uint32_t radialCount)
+{
+    assert(radialCount > 0);
+    assert(symmetryCopies(brush->mirrors, radialCount) <= DALI_MAX_SYMMETRY_COPIES);
+    brush->radialAxis = axis;
+    brush->radialCount = radialCount;
+    brush->dirt |= BRUSH_GENERAL_BIT;
 }
 
 void dali_SetBrushSpacing(Dali_Brush* brush, float spacing)
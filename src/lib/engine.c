@@ -2,6 +2,8 @@
 #include "dtags.h"
 #include "layer.h"
 #include "private.h"
+#include "rng.h"
+#include "pattern.h"
 #include "ubo-shared.h"
 #include "undo.h"
 #include "stdlib.h"
@@ -37,20 +39,61 @@ enum { DESC_SET_PRIM, DESC_SET_PAINT, DESC_SET_COMP, DESC_SET_COUNT };
 
 enum {
     PIPELINE_COMP_1,
-    PIPELINE_COMP_2,
     PIPELINE_COMP_3,
     PIPELINE_COMP_4,
-    PIPELINE_COMP_SINGLE,
+    PIPELINE_COMP_BACKGROUND,
+    PIPELINE_COMP_FOREGROUND,
+    PIPELINE_COMP_DAB_PREVIEW,
     PIPELINE_COMP_COUNT
 };
 
 #define PRIM_DIRTY_BITS (DALI_PRIM_ADDED_BIT | DALI_PRIM_CHANGED_BIT)
 
+// edge of the tiles group images are rebuilt in. bounds the memory the 
+// batch's layer copies take.
+#define COMP_TILE_SIZE 1024
+
+#define PAINT_PC_STAGES                                                        \
+    (VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_VERTEX_BIT |             \
+     VK_SHADER_STAGE_FRAGMENT_BIT)
+
 typedef Obdn_BufferRegion BufferRegion;
 
 typedef Obdn_Command Command;
 typedef Obdn_Image   Image;
 
+// ray sample sets are Poisson disks of 256 * 4^i points
+#define SAMPLE_PATTERN_COUNT 5
+
+// dabs a fast stroke can run ahead of the gpu before frames go over budget
+#define DAB_QUEUE_SIZE 256
+// frames that may still be in flight when their timestamps are read back
+#define TIMESTAMP_SLOTS 4
+
+typedef struct SamplePattern {
+    uint32_t offset; // in points
+    uint32_t count;
+    float    lod;    // brush tip lod at this density. only set per tip.
+} SamplePattern;
+
+typedef struct PickRequest {
+    float       x;
+    float       y;
+    Dali_PickFn fn;
+    void*       data;
+} PickRequest;
+
+typedef struct Dab {
+    Vec2            pos;
+    Vec2            prevPos; // where a smudge picks paint up from
+    float           angle;
+    Dali_BrushTipId tip;
+    uint32_t        stroke;
+    uint32_t        index;   // within the stroke
+    uint32_t        pattern; // sample pattern at the time it was made
+    uint32_t        sample;  // pattern points already traced
+} Dab;
+
 typedef enum EngineState {
     DEAD, // will cause paint to return if engine struct is 0'd out
     READY,
@@ -60,6 +103,9 @@ typedef enum EngineState {
 typedef struct Dali_Engine {
     BufferRegion matrixRegion;
     BufferRegion brushRegion;
+    Vec2*         patternPoints; // host only; the gpu gets per tip lists
+    SamplePattern samplePatterns[SAMPLE_PATTERN_COUNT];
+    uint32_t      samplePattern;
 
     VkPipeline                paintPipeline;
     Obdn_R_ShaderBindingTable shaderBindingTable;
@@ -83,10 +129,47 @@ typedef struct Dali_Engine {
     Image imageB;
     Image imageC; // primarily background layers
     Image imageD; // primarily foreground layers
+    // set when the stack can't be split into C, B and D without changing 
+    // how it blends. each frame composites everything from liveStart up 
+    // over C instead: the active layer, or the outermost group holding it 
+    // that isn't passed through, and the layers above.
+    bool              liveComp;
+    Dali_LayerId      liveStart;
+    Dali_LayerGroupId isolatedGroup;
+    // B copied out for that, and what the compositor reads in place of 
+    // the active layer's buffer while it runs
+    BufferRegion        activeCopy;
+    const BufferRegion* activeSource;
+    // the slices of a progressively traced dab gather here between frames. 
+    // dabRegion keeps what the dirty region covered before resets, so a 
+    // dab's texels are known once its last slice comes round.
+    Image        dabImage;
+    DirtyRegion  dabRegion;
+    // read only copy of imageB for brushes that sample the layer. only the 
+    // dirty region is refreshed, once per frame, before any dab is traced.
+    Image        snapshotImage;
+    BufferRegion dirtyRegion;
+    bool         snapshotStale;
+    // the last paint submission's. the host only touches what the gpu 
+    // writes back, or reads, once it has signaled. without one the device 
+    // is waited idle instead.
+    VkFence      frameFence;
+    bool         framePending;
+    // layer the snapshot was filled from when cloning from a layer other 
+    // than the active one. a null buffer when the snapshot mirrors imageB.
+    BufferRegion snapshotSource;
+    // a tile of each layer in a composite batch, copied from its buffer
+    Image        compTiles[COMP_BATCH_SIZE];
+    uint32_t     compTileSize;
     
-    // default alpha is created once and 
-    // it is shared by all brushes across 
-    Image defaultBrushAlpha; 
+    // brush tip library. tip 0 is the default alpha, created once and 
+    // shared by all brushes. tips are bound as one descriptor array and 
+    // picked by push constant, so switching tips never touches descriptors.
+    Image    brushTips[DALI_MAX_BRUSH_TIPS];
+    uint32_t brushTipCount;
+    // each tip's patterns with the points the tip doesn't cover removed
+    BufferRegion  tipSamples[DALI_MAX_BRUSH_TIPS];
+    SamplePattern tipPatterns[DALI_MAX_BRUSH_TIPS][SAMPLE_PATTERN_COUNT];
 
     VkFramebuffer applyPaintFrameBuffer;
     VkFramebuffer compositeFrameBuffer;
@@ -106,8 +189,24 @@ typedef struct Dali_Engine {
 
     Obdn_R_AccelerationStructure bottomLevelAS;
     Obdn_R_AccelerationStructure topLevelAS;
+    BufferRegion                 triangles; // TriangleRecords of the active prim
+    const Obdn_Geometry*         activeGeo;
+    // the acceleration structures wait for a dab that has to be traced
+    bool                         accelStale;
+
+    // set when the active prim is flat and its uvs are an affine map of its 
+    // positions. dabs on it are stamped into uv space by a raster pass.
+    bool         canvas;
+    Vec3         canvasOrigin; // pos = origin + u * uv.x + v * uv.y
+    Vec3         canvasU;
+    Vec3         canvasV;
+    VkRenderPass  stampRenderPass;
+    VkFramebuffer stampFrameBuffer;
+    VkPipeline    stampPipeline;
 
     Dali_LayerId curLayerId;
+    // the active layer's blend, read by the composite every frame
+    CompPushConstants activeLayerComp;
 
     Obdn_MaterialHandle  activeMaterial;
     Obdn_PrimitiveHandle activePrim;
@@ -119,12 +218,51 @@ typedef struct Dali_Engine {
     bool                 brushActive;
     bool                 brushWasActive;
     float                strokeLength;
+    uint32_t             strokeId;
+    uint32_t             dabCount; // in the current stroke
     float                brushSpacing;
-    uint32_t             rayWidth; // sqrt of ray count (rays per splat)
+    uint32_t             rayWidth; // rays across the brush; picks the sample pattern
     Vec2                 brushPos;
     Vec2                 prevBrushPos;
+    Vec2                 prevDabPos;
+    Dali_PaintMode       paintMode;
     float                brushAngle;
     float                brushAngleVariation;
+    Dali_BrushTipId      brushTip;
+    uint32_t             brushTipSetSize;
+    uint32_t             symmetryCopies; // launch depth of each splat
+    // dabs waiting to be traced, oldest first. each frame draws as many as 
+    // its ray budget allows and leaves the rest to the frames after it.
+    Dab                  dabQueue[DAB_QUEUE_SIZE];
+    uint32_t             dabQueueHead;
+    uint32_t             dabQueueCount;
+    // a camera or brush change leaves the queue to the next frame's 
+    // command buffer along with the ubos and launch depth it was made for
+    bool                 flushDeferred;
+    UboMatrices          flushMatrices;
+    UboBrush             flushBrush;
+    uint32_t             flushSymmetryCopies;
+    float                frameBudget; // ms of dab work per frame. 0 is unlimited
+    double               nsPerRay;    // running estimate from the timestamps
+    float                timestampPeriod; // ns per tick
+    uint64_t             timestampMask;   // the graphics queue's valid bits
+    VkQueryPool          timestampPool;
+    uint32_t             timestampSlot;
+    uint32_t             timestampRays[TIMESTAMP_SLOTS]; // 0 if nothing to read
+    // rays per frame spent on the dab under a resting brush. 0 traces it 
+    // whole at once.
+    uint32_t             progressiveRays;
+    // picks are traced after the composite of the frame after they're 
+    // requested and handed back once their records come back done. one 
+    // batch is in flight at a time; the rest wait in the queue.
+    VkPipeline                pickPipeline;
+    Obdn_R_ShaderBindingTable pickShaderBindingTable;
+    BufferRegion              pickRegion; // PickRecords
+    PickRequest               pickQueue[DALI_MAX_PICKS];
+    uint32_t                  pickQueueCount;
+    PickRequest               picksInFlight[DALI_MAX_PICKS];
+    uint32_t                  pickFlightCount;
+    uint32_t                  pickBatch;
     Obdn_Memory*         memory;
     const Obdn_Instance* instance;
     VkDevice             device;
@@ -132,17 +270,49 @@ typedef struct Dali_Engine {
 
 typedef Dali_Engine Engine;
 
+// everything that changes with the texture format
+typedef struct {
+    VkFormat    vkFormat;
+    uint32_t    texelSize;
+    bool        coverage; // one channel of coverage in red, no color
+    const char* paintRaygen;
+    const char* pickRaygen;
+} FormatInfo;
+
+static const FormatInfo formatInfos[] = {
+    [DALI_FORMAT_R8G8B8A8_UNORM]      = {VK_FORMAT_B8G8R8A8_UNORM, 4, false,
+                                         SPVDIR "/paint.rgen.spv",
+                                         SPVDIR "/pick.rgen.spv"},
+    [DALI_FORMAT_R32_SFLOAT]          = {VK_FORMAT_R32_SFLOAT, 4, true,
+                                         SPVDIR "/paint32R.rgen.spv",
+                                         SPVDIR "/pick32R.rgen.spv"},
+    [DALI_FORMAT_R16G16B16A16_SFLOAT] = {VK_FORMAT_R16G16B16A16_SFLOAT, 8, false,
+                                         SPVDIR "/paint16RGBA.rgen.spv",
+                                         SPVDIR "/pick16RGBA.rgen.spv"},
+    [DALI_FORMAT_R8_UNORM]            = {VK_FORMAT_R8_UNORM, 1, true,
+                                         SPVDIR "/paint8R.rgen.spv",
+                                         SPVDIR "/pick8R.rgen.spv"},
+    [DALI_FORMAT_R16_UNORM]           = {VK_FORMAT_R16_UNORM, 2, true,
+                                         SPVDIR "/paint16R.rgen.spv",
+                                         SPVDIR "/pick16R.rgen.spv"},
+    [DALI_FORMAT_R32G32B32A32_SFLOAT] = {VK_FORMAT_R32G32B32A32_SFLOAT, 16, false,
+                                         SPVDIR "/paint32RGBA.rgen.spv",
+                                         SPVDIR "/pick32RGBA.rgen.spv"},
+};
+
+static const FormatInfo*
+formatInfo(const Engine* engine)
+{
+    assert(engine->textureFormat < LEN(formatInfos));
+    return &formatInfos[engine->textureFormat];
+}
+
 #define DTAG PAINT_DEBUG_TAG_PAINT
 
 static void
 initPaintImages(Dali_Engine* engine)
 {
-    VkFormat textureFormat;
-    switch (engine->textureFormat)
-    {
-        case DALI_FORMAT_R8G8B8A8_UNORM: textureFormat = VK_FORMAT_B8G8R8A8_UNORM; break; 
-        case DALI_FORMAT_R32_SFLOAT:     textureFormat = VK_FORMAT_R32_SFLOAT; break;
-    }
+    const VkFormat textureFormat = formatInfo(engine)->vkFormat;
     engine->imageA = obdn_CreateImageAndSampler(
         engine->memory, engine->textureSize, engine->textureSize,
         textureFormat,
@@ -180,6 +350,13 @@ initPaintImages(Dali_Engine* engine)
         VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1, VK_FILTER_LINEAR,
         OBDN_MEMORY_DEVICE_TYPE);
 
+    engine->snapshotImage = obdn_CreateImageAndSampler(
+        engine->memory, engine->textureSize, engine->textureSize,
+        textureFormat,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1, VK_FILTER_NEAREST,
+        OBDN_MEMORY_DEVICE_TYPE);
+
     obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                &engine->imageA);
@@ -192,11 +369,26 @@ initPaintImages(Dali_Engine* engine)
     obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                &engine->imageD);
+    obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               &engine->snapshotImage);
+
+    engine->dabImage = obdn_CreateImageAndSampler(
+        engine->memory, engine->textureSize, engine->textureSize,
+        textureFormat,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1, VK_FILTER_NEAREST,
+        OBDN_MEMORY_DEVICE_TYPE);
+
+    obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_GENERAL, &engine->dabImage);
 
     obdn_v_ClearColorImage(&engine->imageA);
     obdn_v_ClearColorImage(&engine->imageB);
     obdn_v_ClearColorImage(&engine->imageC);
     obdn_v_ClearColorImage(&engine->imageD);
+    obdn_v_ClearColorImage(&engine->snapshotImage);
 
     obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
@@ -210,18 +402,40 @@ initPaintImages(Dali_Engine* engine)
     obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                &engine->imageD);
+    obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               &engine->snapshotImage);
+
+    engine->compTileSize = MIN(engine->textureSize, COMP_TILE_SIZE);
+    assert(engine->textureSize % engine->compTileSize == 0);
+    for (int i = 0; i < COMP_BATCH_SIZE; i++)
+    {
+        engine->compTiles[i] = obdn_CreateImageAndSampler(
+            engine->memory, engine->compTileSize, engine->compTileSize,
+            textureFormat,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
+            VK_FILTER_NEAREST, OBDN_MEMORY_DEVICE_TYPE);
+        obdn_TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                   &engine->compTiles[i]);
+    }
+
+    engine->activeCopy = obdn_RequestBufferRegion(
+        engine->memory,
+        (VkDeviceSize)engine->textureSize * engine->textureSize *
+            formatInfo(engine)->texelSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        OBDN_MEMORY_DEVICE_TYPE);
+
+    engine->snapshotStale = true;
 }
 
 static void
 initRenderPasses(Engine* engine)
 {
     // apply paint renderpass
-    VkFormat textureFormat;
-    switch (engine->textureFormat)
-    {
-        case DALI_FORMAT_R8G8B8A8_UNORM: textureFormat = VK_FORMAT_B8G8R8A8_UNORM; break; 
-        case DALI_FORMAT_R32_SFLOAT:     textureFormat = VK_FORMAT_R32_SFLOAT; break;
-    }
+    const VkFormat textureFormat = formatInfo(engine)->vkFormat;
 
     {
         const VkAttachmentDescription attachmentA = {
@@ -350,23 +564,18 @@ initRenderPasses(Engine* engine)
             .attachment = 3,
             .layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
-        VkSubpassDescription subpass1 = {
-            .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
-            .colorAttachmentCount    = 1,
-            .pColorAttachments       = &referenceA2,
-            .pDepthStencilAttachment = NULL,
-            .inputAttachmentCount    = 1,
-            .pInputAttachments       = &referenceC2,
-            .preserveAttachmentCount = 0,
-        };
+        // the active layer's blend reads the background itself, so both 
+        // go down in one subpass
+        const VkAttachmentReference referencesCB2[] = {referenceC2,
+                                                        referenceB2};
 
         VkSubpassDescription subpass2 = {
             .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
             .colorAttachmentCount    = 1,
             .pColorAttachments       = &referenceA2,
             .pDepthStencilAttachment = NULL,
-            .inputAttachmentCount    = 1,
-            .pInputAttachments       = &referenceB2,
+            .inputAttachmentCount    = LEN(referencesCB2),
+            .pInputAttachments       = referencesCB2,
             .preserveAttachmentCount = 0,
         };
 
@@ -389,26 +598,18 @@ initRenderPasses(Engine* engine)
             .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
         };
 
-        const VkSubpassDependency dependency2 = {
+        const VkSubpassDependency dependency3 = {
             .srcSubpass    = 0,
             .dstSubpass    = 1,
             .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
             .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
-        };
-
-        const VkSubpassDependency dependency3 = {
-            .srcSubpass    = 1,
-            .dstSubpass    = 2,
-            .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+            .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
         };
 
         const VkSubpassDependency dependency4 = {
-            .srcSubpass    = 2,
+            .srcSubpass    = 1,
             .dstSubpass    = VK_SUBPASS_EXTERNAL,
             .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
             .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
@@ -417,14 +618,12 @@ initRenderPasses(Engine* engine)
         };
 
         VkSubpassDescription subpasses[] = {
-            subpass1,
             subpass2,
             subpass3,
         };
 
         VkSubpassDependency dependencies[] = {
             dependency1,
-            dependency2,
             dependency3,
             dependency4,
         };
@@ -447,15 +646,6 @@ initRenderPasses(Engine* engine)
     }
 
     {
-        const VkAttachmentDescription srcAttachment = {
-            .format        = textureFormat,
-            .samples       = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp        = VK_ATTACHMENT_LOAD_OP_LOAD,
-            .storeOp       = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .finalLayout   = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        };
-
         const VkAttachmentDescription dstAttachment = {
             .format        = textureFormat,
             .samples       = VK_SAMPLE_COUNT_1_BIT,
@@ -465,13 +655,13 @@ initRenderPasses(Engine* engine)
             .finalLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         };
 
-        const VkAttachmentReference refSrc = {
-            .attachment = 0,
-            .layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-
+        // the group image is read as well as written so the layers' blend 
+        // modes can see what's under them. one quad over the tile touches 
+        // each texel once, so the loop is safe. the layers themselves are 
+        // sampled from compTiles.
         const VkAttachmentReference refDst = {
-            .attachment = 1,
-            .layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+            .attachment = 0,
+            .layout     = VK_IMAGE_LAYOUT_GENERAL};
 
         const VkSubpassDescription subpass = {
             .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -479,7 +669,7 @@ initRenderPasses(Engine* engine)
             .pColorAttachments       = &refDst,
             .pDepthStencilAttachment = NULL,
             .inputAttachmentCount    = 1,
-            .pInputAttachments       = &refSrc,
+            .pInputAttachments       = &refDst,
             .preserveAttachmentCount = 0,
         };
 
@@ -487,10 +677,12 @@ initRenderPasses(Engine* engine)
             {
                 .srcSubpass    = VK_SUBPASS_EXTERNAL,
                 .dstSubpass    = 0,
-                .srcStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT,
-                .srcAccessMask = 0,
+                .srcStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT |
+                                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
                 .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
             },
             {
                 .srcSubpass    = 0,
@@ -501,15 +693,12 @@ initRenderPasses(Engine* engine)
                 .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
             }};
 
-        const VkAttachmentDescription attachments[] = {srcAttachment,
-                                                       dstAttachment};
-
         VkRenderPassCreateInfo ci = {
             .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
             .subpassCount    = 1,
             .pSubpasses      = &subpass,
-            .attachmentCount = LEN(attachments),
-            .pAttachments    = attachments,
+            .attachmentCount = 1,
+            .pAttachments    = &dstAttachment,
             .dependencyCount = LEN(dependencies),
             .pDependencies   = dependencies,
         };
@@ -517,13 +706,106 @@ initRenderPasses(Engine* engine)
         V_ASSERT(vkCreateRenderPass(engine->device, &ci, NULL,
                                     &engine->singleCompositeRenderPass));
     }
+
+    // stamp renderpass. draws a dab into imageA in place of the raygen.
+    {
+        const VkAttachmentDescription attachmentA = {
+            .format        = textureFormat,
+            .samples       = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp        = VK_ATTACHMENT_LOAD_OP_LOAD,
+            .storeOp       = VK_ATTACHMENT_STORE_OP_STORE,
+            .initialLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .finalLayout   = VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        const VkAttachmentReference refA = {
+            .attachment = 0,
+            .layout     = VK_IMAGE_LAYOUT_GENERAL};
+
+        const VkSubpassDescription subpass = {
+            .pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .colorAttachmentCount = 1,
+            .pColorAttachments    = &refA,
+        };
+
+        const VkSubpassDependency dependencies[] = {
+            {
+                .srcSubpass    = VK_SUBPASS_EXTERNAL,
+                .dstSubpass    = 0,
+                .srcStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            },
+            {
+                .srcSubpass    = 0,
+                .dstSubpass    = VK_SUBPASS_EXTERNAL,
+                .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+            }};
+
+        VkRenderPassCreateInfo ci = {
+            .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .subpassCount    = 1,
+            .pSubpasses      = &subpass,
+            .attachmentCount = 1,
+            .pAttachments    = &attachmentA,
+            .dependencyCount = LEN(dependencies),
+            .pDependencies   = dependencies,
+        };
+
+        V_ASSERT(vkCreateRenderPass(engine->device, &ci, NULL,
+                                    &engine->stampRenderPass));
+    }
+}
+
+static void
+growRegion(DirtyRegion* region, const DirtyRegion* by)
+{
+    region->minX = MIN(region->minX, by->minX);
+    region->minY = MIN(region->minY, by->minY);
+    region->maxX = MAX(region->maxX, by->maxX);
+    region->maxY = MAX(region->maxY, by->maxY);
+}
+
+// the region so far goes to dabRegion first: a resting dab's earlier 
+// slices may have been traced before the reset
+static void
+resetDirtyRegion(Engine* engine)
+{
+    DirtyRegion* region = (DirtyRegion*)engine->dirtyRegion.hostData;
+    growRegion(&engine->dabRegion, region);
+    region->minX = UINT32_MAX;
+    region->minY = UINT32_MAX;
+    region->maxX = 0;
+    region->maxY = 0;
+}
+
+// makes the raygens' writes to host mapped buffers visible to the host 
+// once the submission's fence has signaled
+static void
+hostReadBarrier(const VkCommandBuffer cmdBuf)
+{
+    const VkMemoryBarrier barrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL,
+                         0, NULL);
 }
 
 static void
 initUniformBuffers(Engine* engine)
 {
+    // transfer dst so a deferred flush can put back, and then restore, 
+    // what its dabs were made for
     engine->matrixRegion = obdn_RequestBufferRegion(
-        engine->memory, sizeof(UboMatrices), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        engine->memory, sizeof(UboMatrices),
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         OBDN_MEMORY_HOST_GRAPHICS_TYPE);
     UboMatrices* matrices = (UboMatrices*)engine->matrixRegion.hostData;
     matrices->model       = coal_Ident_Mat4();
@@ -533,19 +815,253 @@ initUniformBuffers(Engine* engine)
     matrices->projInv     = coal_Ident_Mat4();
 
     engine->brushRegion = obdn_RequestBufferRegion(
-        engine->memory, sizeof(UboBrush), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        engine->memory, sizeof(UboBrush),
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+
+    engine->dirtyRegion = obdn_RequestBufferRegion(
+        engine->memory, sizeof(DirtyRegion), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+    resetDirtyRegion(engine);
+
+    engine->pickRegion = obdn_RequestBufferRegion(
+        engine->memory, sizeof(PickRecord) * DALI_MAX_PICKS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+}
+
+static void
+initSamplePatterns(Engine* engine)
+{
+    uint32_t capacity = 0;
+    for (int i = 0; i < SAMPLE_PATTERN_COUNT; i++)
+        capacity += PATTERN_CAPACITY(256u << (2 * i));
+
+    engine->patternPoints = hell_Malloc(sizeof(Vec2) * capacity);
+
+    uint32_t offset = 0;
+    for (int i = 0; i < SAMPLE_PATTERN_COUNT; i++)
+    {
+        const uint32_t count = pattern_PoissonDisc(256u << (2 * i), i,
+                                                   engine->patternPoints + offset);
+        engine->samplePatterns[i] = (SamplePattern){offset, count, 0.0};
+        offset += count;
+    }
+}
+
+static void
+initTimestamps(Engine* engine)
+{
+    const VkQueryPoolCreateInfo info = {
+        .sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType  = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * TIMESTAMP_SLOTS};
+
+    V_ASSERT(vkCreateQueryPool(engine->device, &info, NULL,
+                               &engine->timestampPool));
+
+    const VkPhysicalDevice physicalDevice =
+        obdn_GetPhysicalDevice(engine->instance);
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    engine->timestampPeriod = props.limits.timestampPeriod;
+
+    // the counter wraps at timestampValidBits; the rest of each result is 0
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties* families =
+        hell_Malloc(familyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                             families);
+    assert(engine->graphicsQueueFamilyIndex < familyCount);
+    const uint32_t validBits =
+        families[engine->graphicsQueueFamilyIndex].timestampValidBits;
+    engine->timestampMask = validBits < 64 ? (1ull << validBits) - 1 : ~0ull;
+    hell_Free(families);
+}
+
+// lod at which one texel of the tip covers the area of one ray when 
+// rayCount rays are spread over its inscribed disc. sampling any finer 
+// than that just aliases the tip.
+static float
+tipLod(uint32_t width, uint32_t height, uint32_t rayCount)
+{
+    const float raysAcross   = sqrtf(rayCount * 4.0 / M_PI);
+    const float texelsPerRay = MAX(width, height) / raysAcross;
+    return MAX(log2f(texelsPerRay), 0.0);
+}
+
+// bytes per texel of the tip formats we can read back. 0 for anything 
+// else, in which case nothing is culled.
+static uint32_t
+tipTexelSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8_UNORM: return 1;
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_UNORM: return 4;
+    default: return 0;
+    }
+}
+
+// looks at the channel the raygen reads, which is red
+static bool
+tipTexelNonZero(const uint8_t* texel, VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R32_SFLOAT:
+    {
+        float f;
+        memcpy(&f, texel, sizeof(f));
+        return f > 0.0;
+    }
+    case VK_FORMAT_B8G8R8A8_UNORM: return texel[2] > 0;
+    default: return texel[0] > 0;
+    }
+}
+
+// q is in the tip's unit disc. keeps the point if any texel within one 
+// of its bilinear footprint is nonzero, which covers the blend with the 
+// finer level and unorm rounding in the downsampled levels.
+static bool
+tipCovers(const uint8_t* texels, VkFormat format, uint32_t width,
+          uint32_t height, Vec2 q)
+{
+    const uint32_t texelSize = tipTexelSize(format);
+    const int      x0 = (int)floorf((q.x * 0.5 + 0.5) * width - 0.5) - 1;
+    const int      y0 = (int)floorf((q.y * 0.5 + 0.5) * height - 0.5) - 1;
+    for (int y = MAX(y0, 0); y <= MIN(y0 + 3, (int)height - 1); y++)
+        for (int x = MAX(x0, 0); x <= MIN(x0 + 3, (int)width - 1); x++)
+        {
+            if (tipTexelNonZero(texels + (y * width + x) * texelSize, format))
+                return true;
+        }
+    return false;
+}
+
+// reads back the mip level each pattern density samples the tip at and 
+// keeps only the points where the tip is nonzero, so no ray is launched 
+// that could only write zero.
+static void
+compactTipSamples(Engine* engine, Dali_BrushTipId tipId)
+{
+    const Image*   tip       = &engine->brushTips[tipId];
+    const uint32_t width     = tip->extent.width;
+    const uint32_t height    = tip->extent.height;
+    const uint32_t texelSize = tipTexelSize(tip->format);
+
+    VkBufferImageCopy copies[SAMPLE_PATTERN_COUNT];
+    VkDeviceSize      stagingSize = 0;
+    for (int i = 0; i < SAMPLE_PATTERN_COUNT; i++)
+    {
+        const float lod = tipLod(width, height, engine->samplePatterns[i].count);
+        engine->tipPatterns[tipId][i].lod = lod;
+        // a fractional lod blends towards the coarser level, whose nonzero 
+        // texels are a superset of the finer one's
+        const uint32_t level = MIN((uint32_t)ceilf(lod), tip->mipLevels - 1);
+        copies[i] = (VkBufferImageCopy){
+            .bufferOffset     = stagingSize,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+            .imageExtent      = {MAX(width >> level, 1),
+                                 MAX(height >> level, 1), 1}};
+        stagingSize += texelSize * copies[i].imageExtent.width *
+                       copies[i].imageExtent.height;
+    }
+
+    BufferRegion staging = {0};
+    if (texelSize > 0)
+    {
+        staging = obdn_RequestBufferRegion(engine->memory, stagingSize,
+                                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+        for (int i = 0; i < SAMPLE_PATTERN_COUNT; i++)
+            copies[i].bufferOffset += staging.offset;
+
+        Obdn_Command cmd = obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+        const VkImageMemoryBarrier barrier = {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .image            = tip->handle,
+            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout        = tip->layout,
+            .newLayout        = tip->layout,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, tip->mipLevels, 0, 1}};
+
+        obdn_BeginCommandBuffer(cmd.buffer);
+
+        vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                             NULL, 1, &barrier);
+
+        vkCmdCopyImageToBuffer(cmd.buffer, tip->handle, tip->layout,
+                               staging.buffer, LEN(copies), copies);
+
+        obdn_EndCommandBuffer(cmd.buffer);
+
+        obdn_SubmitAndWait(&cmd, 0);
+
+        obdn_DestroyCommand(cmd);
+    }
+
+    const SamplePattern* last = &engine->samplePatterns[SAMPLE_PATTERN_COUNT - 1];
+    Vec2*    kept  = hell_Malloc(sizeof(Vec2) * (last->offset + last->count));
+    uint32_t count = 0;
+    for (int i = 0; i < SAMPLE_PATTERN_COUNT; i++)
+    {
+        const SamplePattern* pattern = &engine->samplePatterns[i];
+        const uint8_t* texels = texelSize > 0 ?
+            staging.hostData + copies[i].bufferOffset - staging.offset : NULL;
+        engine->tipPatterns[tipId][i].offset = count;
+        for (uint32_t p = 0; p < pattern->count; p++)
+        {
+            const Vec2 q = engine->patternPoints[pattern->offset + p];
+            if (texelSize == 0 ||
+                tipCovers(texels, tip->format, copies[i].imageExtent.width,
+                          copies[i].imageExtent.height, q))
+                kept[count++] = q;
+        }
+        engine->tipPatterns[tipId][i].count = count - engine->tipPatterns[tipId][i].offset;
+    }
+
+    if (texelSize > 0)
+        obdn_FreeBufferRegion(&staging);
+
+    // an empty tip still needs something to bind
+    engine->tipSamples[tipId] = obdn_RequestBufferRegion(
+        engine->memory, sizeof(Vec2) * MAX(count, 1),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+    memcpy(engine->tipSamples[tipId].hostData, kept, sizeof(Vec2) * count);
+
+    hell_Free(kept);
+}
+
+// picks the pattern that matches the ray density of a rayWidth x rayWidth 
+// grid over the brush disc. blue noise covers the disc far more evenly 
+// than a jittered grid of the same count, so lower widths hold up well.
+static void
+selectSamplePattern(Engine* engine)
+{
+    const float target = engine->rayWidth * engine->rayWidth * M_PI / 4.0;
+    engine->samplePattern = SAMPLE_PATTERN_COUNT - 1;
+    for (int i = 0; i < SAMPLE_PATTERN_COUNT; i++)
+    {
+        if (engine->samplePatterns[i].count >= target)
+        {
+            engine->samplePattern = i;
+            break;
+        }
+    }
 }
 
 static void
 initDescSetsAndPipeLayouts(Engine* engine)
 {
     Obdn_DescriptorBinding bindingsA[] = {
-        {// uv buffer
-         .descriptorCount = 1,
-         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-         .stageFlags      = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR},
-        {// index buffer
+        {// triangle records
          .descriptorCount = 1,
          .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
          .stageFlags      = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR},
@@ -559,19 +1075,46 @@ initDescSetsAndPipeLayouts(Engine* engine)
         {// matrices
          .descriptorCount = 1,
          .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR |
+                       VK_SHADER_STAGE_FRAGMENT_BIT},
         {// brush
          .descriptorCount = 1,
          .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR |
+                       VK_SHADER_STAGE_FRAGMENT_BIT},
         {// paint image
          .descriptorCount = 1,
          .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
          .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
-        {// alpha image
+        {// brush tips
+         .descriptorCount = DALI_MAX_BRUSH_TIPS,
+         .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR |
+                       VK_SHADER_STAGE_FRAGMENT_BIT},
+        {// layer snapshot
+         .descriptorCount = 1,
+         .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+        {// dirty region
+         .descriptorCount = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+        {// per tip sample patterns
+         .descriptorCount = DALI_MAX_BRUSH_TIPS,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+        {// pick records
+         .descriptorCount = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+        {// slices of a resting dab
+         .descriptorCount = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+        {// the same, for the preview over the composite
          .descriptorCount = 1,
          .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-         .stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR}
+         .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT}
     };
 
     Obdn_DescriptorBinding bindingsC[] = {
@@ -594,6 +1137,21 @@ initDescSetsAndPipeLayouts(Engine* engine)
             .descriptorCount = 1,
             .type            = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
             .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {// background group, read while it's the target
+            .descriptorCount = 1,
+            .type            = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+            .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {// foreground group, likewise
+            .descriptorCount = 1,
+            .type            = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+            .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {// layers of a composite batch
+            .descriptorCount = COMP_BATCH_SIZE,
+            .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
         }};
 
     const Obdn_DescriptorSetInfo descSets[] = {
@@ -616,10 +1174,12 @@ initDescSetsAndPipeLayouts(Engine* engine)
                               engine->descriptorSetLayouts,
                               &engine->description);
 
-    // seedx, seedy, x, y, angle
-    VkPushConstantRange pcRange = {.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-                                   .offset     = 0,
-                                   .size       = sizeof(float) * 5};
+    // every device gives at least 128 bytes
+    _Static_assert(sizeof(CompBatchPushConstants) <= 128, "batch too big");
+    VkPushConstantRange pcRange = {
+        .stageFlags = PAINT_PC_STAGES,
+        .offset     = 0,
+        .size = MAX(sizeof(StampPushConstants), sizeof(CompBatchPushConstants))};
 
     const Obdn_PipelineLayoutInfo pipeLayoutInfos[] = {
         {.descriptorSetCount   = LEN(descSets),
@@ -635,7 +1195,7 @@ static void
 createDefaultBrushAlpha(Engine* engine)
 {
     Obdn_Image image = obdn_CreateImageAndSampler(engine->memory, 32, 32, VK_FORMAT_R32_SFLOAT,
-                     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                      VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1, VK_FILTER_LINEAR, OBDN_MEMORY_DEVICE_TYPE);
 
     Obdn_Command cmd = obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
@@ -683,74 +1243,198 @@ createDefaultBrushAlpha(Engine* engine)
 
     obdn_SubmitAndWait(&cmd, 0);
 
-    engine->defaultBrushAlpha = image;
+    image.layout = VK_IMAGE_LAYOUT_GENERAL;
+
+    engine->brushTips[0]  = image;
+    engine->brushTipCount = 1;
+    compactTipSamples(engine, 0);
 }
 
-static void
-updateDescSetPrim(Engine* engine, const Obdn_Scene* scene)
+// copies the brush alpha into an engine owned image and builds a full mip 
+// chain for it by successive linear blits. the raygen picks a level from 
+// the ray footprint so small dabs don't alias a high res tip.
+// src must have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT.
+static Image
+createBrushTip(Engine* engine, const Image* src)
 {
-    VkWriteDescriptorSetAccelerationStructureKHR asInfo = {
-        .sType =
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
-        .accelerationStructureCount = 1,
-        .pAccelerationStructures    = &engine->topLevelAS.handle};
+    const uint32_t width     = src->extent.width;
+    const uint32_t height    = src->extent.height;
+    const uint32_t mipLevels = (uint32_t)floorf(log2f(MAX(width, height))) + 1;
 
-    Obdn_Primitive* prim = obdn_GetPrimitive(scene, engine->activePrim.id);
+    Image tip = obdn_CreateImageAndSampler(
+        engine->memory, width, height, src->format,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, mipLevels,
+        VK_FILTER_LINEAR, OBDN_MEMORY_DEVICE_TYPE);
 
-    VkDescriptorBufferInfo uvBufInfo = {
-        .offset = obdn_GetAttrOffset(prim->geo, "uv"),
-        .range  = obdn_GetAttrRange(prim->geo, "uv"),
-        .buffer = prim->geo->vertexRegion.buffer,
-    };
+    Obdn_Command cmd = obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
 
-    VkDescriptorBufferInfo indexBufInfo = {
-        .offset = prim->geo->indexRegion.offset,
-        .range  = prim->geo->indexRegion.size,
-        .buffer = prim->geo->indexRegion.buffer,
-    };
+    VkImageMemoryBarrier barrier = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = tip.handle,
+        .srcAccessMask    = 0,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .subresourceRange = {
+            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel   = 0,
+            .levelCount     = mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount     = 1}};
 
-    VkWriteDescriptorSet writes[] = {
-        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-         .dstArrayElement = 0,
-         .dstSet          = engine->description.descriptorSets[DESC_SET_PRIM],
-         .dstBinding      = 0,
-         .descriptorCount = 1,
-         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-         .pBufferInfo     = &uvBufInfo},
-        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-         .dstArrayElement = 0,
-         .dstSet          = engine->description.descriptorSets[DESC_SET_PRIM],
-         .dstBinding      = 1,
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &barrier);
+
+    VkImageBlit blit = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .srcOffsets     = {{0, 0, 0}, {width, height, 1}},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstOffsets     = {{0, 0, 0}, {width, height, 1}}};
+
+    vkCmdBlitImage(cmd.buffer, src->handle, src->layout, tip.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                   VK_FILTER_LINEAR);
+
+    barrier.subresourceRange.levelCount = 1;
+
+    int32_t mipWidth  = width;
+    int32_t mipHeight = height;
+    for (uint32_t i = 1; i < mipLevels; i++)
+    {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                             NULL, 1, &barrier);
+
+        const int32_t nextWidth  = MAX(mipWidth / 2, 1);
+        const int32_t nextHeight = MAX(mipHeight / 2, 1);
+
+        VkImageBlit mipBlit = {
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1},
+            .srcOffsets     = {{0, 0, 0}, {mipWidth, mipHeight, 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+            .dstOffsets     = {{0, 0, 0}, {nextWidth, nextHeight, 1}}};
+
+        vkCmdBlitImage(cmd.buffer, tip.handle,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, tip.handle,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &mipBlit,
+                       VK_FILTER_LINEAR);
+
+        mipWidth  = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // every level but the last was left as a blit source
+    VkImageMemoryBarrier barriers[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = tip.handle,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+         .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+         .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels - 1, 0, 1}},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = tip.handle,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+         .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - 1, 1, 0, 1}}};
+
+    // a single level tip was never a blit source
+    const uint32_t              barrierCount = mipLevels > 1 ? 2 : 1;
+    const VkImageMemoryBarrier* pBarriers    = barriers + (2 - barrierCount);
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0,
+                         NULL, 0, NULL, barrierCount, pBarriers);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+
+    tip.layout = VK_IMAGE_LAYOUT_GENERAL;
+
+    return tip;
+}
+
+static void
+updateDescSetPrim(Engine* engine)
+{
+    VkWriteDescriptorSetAccelerationStructureKHR asInfo = {
+        .sType =
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
+        .accelerationStructureCount = 1,
+        .pAccelerationStructures    = &engine->topLevelAS.handle};
+
+    VkDescriptorBufferInfo triangleBufInfo = {
+        .offset = engine->triangles.offset,
+        .range  = engine->triangles.size,
+        .buffer = engine->triangles.buffer,
+    };
+
+    VkWriteDescriptorSet writes[] = {
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PRIM],
+         .dstBinding      = 0,
          .descriptorCount = 1,
          .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-         .pBufferInfo     = &indexBufInfo},
+         .pBufferInfo     = &triangleBufInfo},
         {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
          .dstArrayElement = 0,
          .dstSet          = engine->description.descriptorSets[DESC_SET_PRIM],
-         .dstBinding      = 2,
+         .dstBinding      = 1,
          .descriptorCount = 1,
          .descriptorType  = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
          .pNext           = &asInfo}};
 
-    vkUpdateDescriptorSets(engine->device, LEN(writes), writes, 0, NULL);
+    // a deferred tlas is written once it's built
+    const uint32_t writeCount = engine->accelStale ? 1 : LEN(writes);
+    vkUpdateDescriptorSets(engine->device, writeCount, writes, 0, NULL);
 }
 
 static void 
-updateDescriptorsAlphaImage(Engine* engine, const Obdn_Image* image)
+updateDescriptorsBrushTip(Engine* engine, Dali_BrushTipId slot, Dali_BrushTipId tip)
 {
+    const Image* image = &engine->brushTips[tip];
     VkDescriptorImageInfo imageInfo = {.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
                                        .imageView   = image->view,
                                        .sampler     = image->sampler};
-    VkWriteDescriptorSet write = {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
-        .dstBinding      = 3,
-        .descriptorCount = 1,
-        .pImageInfo      = &imageInfo
+    VkDescriptorBufferInfo samplesInfo = {
+        .range  = engine->tipSamples[tip].size,
+        .offset = engine->tipSamples[tip].offset,
+        .buffer = engine->tipSamples[tip].buffer,
     };
+    VkWriteDescriptorSet writes[] = {
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 3,
+         .dstArrayElement = slot,
+         .descriptorCount = 1,
+         .pImageInfo      = &imageInfo},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 6,
+         .dstArrayElement = slot,
+         .descriptorCount = 1,
+         .pBufferInfo     = &samplesInfo}};
 
-    vkUpdateDescriptorSets(engine->device, 1, &write, 0, NULL);
+    vkUpdateDescriptorSets(engine->device, LEN(writes), writes, 0, NULL);
 }
 
 static void 
@@ -768,6 +1452,18 @@ updateDescriptorsPaintUBOS(Engine* engine)
         .buffer = engine->brushRegion.buffer,
     };
 
+    VkDescriptorBufferInfo storageInfoDirtyRegion = {
+        .range  = engine->dirtyRegion.size,
+        .offset = engine->dirtyRegion.offset,
+        .buffer = engine->dirtyRegion.buffer,
+    };
+
+    VkDescriptorBufferInfo storageInfoPicks = {
+        .range  = engine->pickRegion.size,
+        .offset = engine->pickRegion.offset,
+        .buffer = engine->pickRegion.buffer,
+    };
+
     VkWriteDescriptorSet writes[] = {
         {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
          .dstArrayElement = 0,
@@ -782,7 +1478,21 @@ updateDescriptorsPaintUBOS(Engine* engine)
          .dstBinding      = 1,
          .descriptorCount = 1,
          .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-         .pBufferInfo     = &uniformInfoBrush}};
+         .pBufferInfo     = &uniformInfoBrush},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 5,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo     = &storageInfoDirtyRegion},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 7,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pBufferInfo     = &storageInfoPicks}};
 
     vkUpdateDescriptorSets(engine->device, LEN(writes), writes, 0, NULL);
 }
@@ -793,28 +1503,63 @@ updateDescriptorsPaintImage(Engine* engine)
     VkDescriptorImageInfo imageInfo = {.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
                                        .imageView   = engine->imageA.view,
                                        .sampler     = engine->imageA.sampler};
-    VkWriteDescriptorSet write =  {
-         .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+
+    VkDescriptorImageInfo snapshotInfo = {
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .imageView   = engine->snapshotImage.view,
+        .sampler     = engine->snapshotImage.sampler};
+
+    VkDescriptorImageInfo dabInfo = {.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                                     .imageView   = engine->dabImage.view,
+                                     .sampler     = engine->dabImage.sampler};
+
+    VkWriteDescriptorSet writes[] = {
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
          .dstArrayElement = 0,
          .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
          .dstBinding      = 2,
          .descriptorCount = 1,
          .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-         .pImageInfo      = &imageInfo};
+         .pImageInfo      = &imageInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 4,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo      = &snapshotInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 8,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &dabInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_PAINT],
+         .dstBinding      = 9,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo      = &dabInfo}};
 
-    vkUpdateDescriptorSets(engine->device, 1, &write, 0, NULL);
+    vkUpdateDescriptorSets(engine->device, LEN(writes), writes, 0, NULL);
 }
 
 static void
-updateAllPaintDescriptors(Engine* engine, const Dali_Brush* brush)
+updateAllPaintDescriptors(Engine* engine)
 {
     updateDescriptorsPaintUBOS(engine);
     updateDescriptorsPaintImage(engine);
 
-    if (brush->alphaImg)
-        updateDescriptorsAlphaImage(engine, brush->alphaImg);
-    else 
-        updateDescriptorsAlphaImage(engine, &engine->defaultBrushAlpha);
+    // unused slots point at the default tip so every element is valid
+    for (Dali_BrushTipId i = 0; i < DALI_MAX_BRUSH_TIPS; i++)
+    {
+        if (i < engine->brushTipCount)
+            updateDescriptorsBrushTip(engine, i, i);
+        else
+            updateDescriptorsBrushTip(engine, i, 0);
+    }
 }
 
 static void
@@ -840,6 +1585,23 @@ updateDescSetComp(Engine* engine)
         .imageView   = engine->imageD.view,
         .sampler     = engine->imageD.sampler};
 
+    VkDescriptorImageInfo imageInfoGroupC = {
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .imageView   = engine->imageC.view,
+        .sampler     = engine->imageC.sampler};
+
+    VkDescriptorImageInfo imageInfoGroupD = {
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .imageView   = engine->imageD.view,
+        .sampler     = engine->imageD.sampler};
+
+    VkDescriptorImageInfo imageInfoTiles[COMP_BATCH_SIZE];
+    for (int i = 0; i < COMP_BATCH_SIZE; i++)
+        imageInfoTiles[i] = (VkDescriptorImageInfo){
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .imageView   = engine->compTiles[i].view,
+            .sampler     = engine->compTiles[i].sampler};
+
     VkWriteDescriptorSet writes[] = {
         {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
          .dstArrayElement = 0,
@@ -868,7 +1630,28 @@ updateDescSetComp(Engine* engine)
          .dstBinding      = 3,
          .descriptorCount = 1,
          .descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
-         .pImageInfo      = &imageInfoD}};
+         .pImageInfo      = &imageInfoD},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_COMP],
+         .dstBinding      = 4,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+         .pImageInfo      = &imageInfoGroupC},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_COMP],
+         .dstBinding      = 5,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+         .pImageInfo      = &imageInfoGroupD},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet          = engine->description.descriptorSets[DESC_SET_COMP],
+         .dstBinding      = 6,
+         .descriptorCount = COMP_BATCH_SIZE,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo      = imageInfoTiles}};
 
     vkUpdateDescriptorSets(engine->device, LEN(writes), writes, 0, NULL);
 }
@@ -876,19 +1659,14 @@ updateDescSetComp(Engine* engine)
 static void
 initPaintPipelineAndShaderBindingTable(Engine* engine)
 {
-    char raygenShader[32];
-    switch (engine->textureFormat)
-    {
-        case DALI_FORMAT_R8G8B8A8_UNORM: strcpy(raygenShader, SPVDIR "/paint.rgen.spv"); break;
-        case DALI_FORMAT_R32_SFLOAT:     strcpy(raygenShader, SPVDIR "/paint32R.rgen.spv"); break;
-    }
+    const char* raygenShader = formatInfo(engine)->paintRaygen;
     const Obdn_RayTracePipelineInfo pipeInfosRT[] = {
         {// ray trace
          .layout      = engine->pipelineLayout,
          .raygenCount = 1,
          .raygenShaders =
              (char*[]){
-                 raygenShader
+                 (char*)raygenShader
              },
          .missCount = 1,
          .missShaders =
@@ -903,29 +1681,76 @@ initPaintPipelineAndShaderBindingTable(Engine* engine)
         &engine->paintPipeline, &engine->shaderBindingTable);
 }
 
+// shares the paint pipeline's layout, miss and hit shaders
+static void
+initPickPipeline(Engine* engine)
+{
+    const char* raygenShader = formatInfo(engine)->pickRaygen;
+    const Obdn_RayTracePipelineInfo pipeInfo = {
+        .layout        = engine->pipelineLayout,
+        .raygenCount   = 1,
+        .raygenShaders = (char*[]){(char*)raygenShader},
+        .missCount     = 1,
+        .missShaders   = (char*[]){SPVDIR "/paint.rmiss.spv"},
+        .chitCount     = 1,
+        .chitShaders   = (char*[]){SPVDIR "/paint.rchit.spv"}};
+
+    obdn_CreateRayTracePipelines(engine->device, engine->memory, 1, &pipeInfo,
+                                 &engine->pickPipeline,
+                                 &engine->pickShaderBindingTable);
+}
+
+static void
+initStampPipeline(Engine* engine)
+{
+    const char* fragShader = formatInfo(engine)->coverage
+                                 ? SPVDIR "/stamp32R.frag.spv"
+                                 : SPVDIR "/stamp.frag.spv";
+
+    const Obdn_GraphicsPipelineInfo pipeInfo = {
+        .layout            = engine->pipelineLayout,
+        .renderPass        = engine->stampRenderPass,
+        .subpass           = 0,
+        .frontFace         = VK_FRONT_FACE_CLOCKWISE,
+        .sampleCount       = VK_SAMPLE_COUNT_1_BIT,
+        .primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .viewportDim       = {engine->textureSize, engine->textureSize},
+        .blendMode         = OBDN_BLEND_MODE_NONE,
+        .vertShader        = SPVDIR "/stamp.vert.spv",
+        .fragShader        = fragShader};
+
+    obdn_CreateGraphicsPipelines(engine->device, 1, &pipeInfo,
+                                 &engine->stampPipeline);
+}
+
 static void
 initCompPipelines(Engine* engine, Dali_PaintMode paintMode)
 {
     Obdn_BlendMode splatBlendMode, compBlendMode;
-    switch (engine->textureFormat)
+    if (!formatInfo(engine)->coverage)
     {
-    case DALI_FORMAT_R8G8B8A8_UNORM: 
         compBlendMode  = OBDN_BLEND_MODE_OVER_NO_PREMUL;
         switch (paintMode)
         {
         case DALI_PAINT_MODE_OVER: splatBlendMode = OBDN_BLEND_MODE_OVER; break;
         case DALI_PAINT_MODE_ERASE: splatBlendMode = OBDN_BLEND_MODE_ERASE; break;
-        } break;
-    case DALI_FORMAT_R32_SFLOAT:
+        // sampled color is laid over the layer it came from
+        case DALI_PAINT_MODE_SMUDGE:
+        case DALI_PAINT_MODE_BLUR:
+        case DALI_PAINT_MODE_SHARPEN:
+        case DALI_PAINT_MODE_CLONE: splatBlendMode = OBDN_BLEND_MODE_OVER; break;
+        }
+    }
+    else
+    {
         compBlendMode  = OBDN_BLEND_MODE_OVER_NO_PREMUL_MONOCHROME;
         switch (paintMode)
         {
-        case DALI_PAINT_MODE_OVER: splatBlendMode = OBDN_BLEND_MODE_OVER_MONOCHROME; break;
         case DALI_PAINT_MODE_ERASE: splatBlendMode = OBDN_BLEND_MODE_ERASE_MONOCHROME; break;
-        } break;
-    default:
-        hell_Print("Error. Unsupported textureFormat\n");
-        exit(1);
+        // syncBrush keeps smudge, blur and sharpen off coverage formats. 
+        // clone has nothing to blend towards and paints like over.
+        default: splatBlendMode = OBDN_BLEND_MODE_OVER_MONOCHROME; break;
+        }
     }
 
     const Obdn_GraphicsPipelineInfo pipeInfo1 = {
@@ -940,34 +1765,23 @@ initCompPipelines(Engine* engine, Dali_PaintMode paintMode)
         .vertShader        = OBDN_FULL_SCREEN_VERT_SPV,
         .fragShader        = SPVDIR "/comp.frag.spv"};
 
-    const Obdn_GraphicsPipelineInfo pipeInfo2 = {
-        .layout            = engine->pipelineLayout,
-        .renderPass        = engine->compositeRenderPass,
-        .subpass           = 0,
-        .frontFace         = VK_FRONT_FACE_CLOCKWISE,
-        .sampleCount       = VK_SAMPLE_COUNT_1_BIT,
-        .primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .viewportDim       = {engine->textureSize, engine->textureSize},
-        .blendMode         = compBlendMode,
-        .vertShader        = OBDN_FULL_SCREEN_VERT_SPV,
-        .fragShader        = SPVDIR "/comp2a.frag.spv"};
-
+    // layer blend modes are evaluated in the shader
     const Obdn_GraphicsPipelineInfo pipeInfo3 = {
         .layout            = engine->pipelineLayout,
         .renderPass        = engine->compositeRenderPass,
-        .subpass           = 1,
+        .subpass           = 0,
         .frontFace         = VK_FRONT_FACE_CLOCKWISE,
         .sampleCount       = VK_SAMPLE_COUNT_1_BIT,
         .primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         .viewportDim       = {engine->textureSize, engine->textureSize},
-        .blendMode         = compBlendMode,
+        .blendMode         = OBDN_BLEND_MODE_NONE,
         .vertShader        = OBDN_FULL_SCREEN_VERT_SPV,
         .fragShader        = SPVDIR "/comp3a.frag.spv"};
 
     const Obdn_GraphicsPipelineInfo pipeInfo4 = {
         .layout            = engine->pipelineLayout,
         .renderPass        = engine->compositeRenderPass,
-        .subpass           = 2,
+        .subpass           = 1,
         .frontFace         = VK_FRONT_FACE_CLOCKWISE,
         .sampleCount       = VK_SAMPLE_COUNT_1_BIT,
         .primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
@@ -976,7 +1790,7 @@ initCompPipelines(Engine* engine, Dali_PaintMode paintMode)
         .vertShader        = OBDN_FULL_SCREEN_VERT_SPV,
         .fragShader        = SPVDIR "/comp4a.frag.spv"};
 
-    const Obdn_GraphicsPipelineInfo pipeInfoSingle = {
+    const Obdn_GraphicsPipelineInfo pipeInfoBackground = {
         .layout            = engine->pipelineLayout,
         .renderPass        = engine->singleCompositeRenderPass,
         .subpass           = 0,
@@ -984,12 +1798,22 @@ initCompPipelines(Engine* engine, Dali_PaintMode paintMode)
         .sampleCount       = VK_SAMPLE_COUNT_1_BIT,
         .primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         .viewportDim       = {engine->textureSize, engine->textureSize},
-        .blendMode         = compBlendMode,
-        .vertShader        = OBDN_FULL_SCREEN_VERT_SPV,
-        .fragShader        = SPVDIR "/comp.frag.spv"};
+        .blendMode         = OBDN_BLEND_MODE_NONE,
+        .vertShader        = SPVDIR "/comptile.vert.spv",
+        .fragShader        = SPVDIR "/compbg.frag.spv"};
+
+    Obdn_GraphicsPipelineInfo pipeInfoForeground = pipeInfoBackground;
+    pipeInfoForeground.fragShader = SPVDIR "/compfg.frag.spv";
 
-    const Obdn_GraphicsPipelineInfo infos[] = {pipeInfo1, pipeInfo2, pipeInfo3,
-                                               pipeInfo4, pipeInfoSingle};
+    // blends like applyPaint, over imageA in the stamp pass
+    Obdn_GraphicsPipelineInfo pipeInfoDabPreview = pipeInfo1;
+    pipeInfoDabPreview.renderPass = engine->stampRenderPass;
+    pipeInfoDabPreview.fragShader = SPVDIR "/dabpreview.frag.spv";
+
+    const Obdn_GraphicsPipelineInfo infos[] = {pipeInfo1, pipeInfo3, pipeInfo4,
+                                               pipeInfoBackground,
+                                               pipeInfoForeground,
+                                               pipeInfoDabPreview};
 
     assert(LEN(infos) == PIPELINE_COMP_COUNT);
 
@@ -1009,6 +1833,21 @@ destroyCompPipelines(Engine* engine)
 static void
 initFramebuffers(Engine* engine)
 {
+    // stampFrameBuffer
+    {
+        VkFramebufferCreateInfo info = {
+            .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .layers          = 1,
+            .height          = engine->textureSize,
+            .width           = engine->textureSize,
+            .renderPass      = engine->stampRenderPass,
+            .attachmentCount = 1,
+            .pAttachments    = &engine->imageA.view};
+
+        V_ASSERT(vkCreateFramebuffer(engine->device, &info, NULL,
+                                     &engine->stampFrameBuffer));
+    }
+
     // applyPaintFrameBuffer
     {
         const VkImageView attachments[] = {
@@ -1050,19 +1889,14 @@ initFramebuffers(Engine* engine)
 
     // backgroundFrameBuffer
     {
-        const VkImageView attachments[] = {
-            engine->imageA.view,
-            engine->imageC.view,
-        };
-
         VkFramebufferCreateInfo info = {
             .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             .layers          = 1,
             .height          = engine->textureSize,
             .width           = engine->textureSize,
             .renderPass      = engine->singleCompositeRenderPass,
-            .attachmentCount = 2,
-            .pAttachments    = attachments};
+            .attachmentCount = 1,
+            .pAttachments    = &engine->imageC.view};
 
         V_ASSERT(vkCreateFramebuffer(engine->device, &info, NULL,
                                      &engine->backgroundFrameBuffer));
@@ -1070,569 +1904,3049 @@ initFramebuffers(Engine* engine)
 
     // foregroundFrameBuffer
     {
-        const VkImageView attachments[] = {
-            engine->imageA.view,
-            engine->imageD.view,
-        };
-
         VkFramebufferCreateInfo info = {
             .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             .layers          = 1,
             .height          = engine->textureSize,
             .width           = engine->textureSize,
             .renderPass      = engine->singleCompositeRenderPass,
-            .attachmentCount = 2,
-            .pAttachments    = attachments};
+            .attachmentCount = 1,
+            .pAttachments    = &engine->imageD.view};
 
         V_ASSERT(vkCreateFramebuffer(engine->device, &info, NULL,
                                      &engine->foregroundFrameBuffer));
     }
 }
 
+static CompPushConstants
+layerComp(const Engine* engine, const Dali_Layer* layer)
+{
+    return (CompPushConstants){
+        .blendMode = layer->blendMode,
+        .opacity   = layer->visible ? layer->opacity : 0.0,
+        .coverage  = formatInfo(engine)->coverage,
+        .mask      = layer->isMask ? layer->maskChannel + 1 : 0,
+        .fill      = {layer->fill[0], layer->fill[1], layer->fill[2]}};
+}
+
+// layers waiting to be laid down over a group image in one pass per tile
+typedef struct {
+    const BufferRegion*    buffers[COMP_BATCH_SIZE];
+    CompBatchPushConstants pc;
+    VkFramebuffer          framebuffer;
+    VkPipeline             pipeline;
+} CompBatch;
+
+// composites the batch into the group image behind its framebuffer, which 
+// must be in color attachment layout. each tile of every layer is copied 
+// into compTiles and the lot blended in one pass over the tile.
 static void
-onLayerChange(Engine* engine, Dali_LayerStack* stack, Dali_LayerId newLayerId)
+drawCompBatch(Engine* engine, const VkCommandBuffer cmdBuf, CompBatch* batch)
 {
-    hell_DebugPrint(PAINT_DEBUG_TAG_PAINT, "Begin\n");
+    const uint32_t count = batch->pc.count;
+    if (count == 0 && !(batch->pc.flags & COMP_BATCH_UNPREMULTIPLY))
+        return;
 
-    Obdn_Command cmd =
-        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+    const uint32_t     size      = engine->textureSize;
+    const uint32_t     tile      = engine->compTileSize;
+    const VkDeviceSize texelSize = formatInfo(engine)->texelSize;
 
-    obdn_BeginCommandBuffer(cmd.buffer);
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
 
-    BufferRegion* prevLayerBuffer =
-        &dali_GetLayer(stack, engine->curLayerId)->bufferRegion;
+    VkImageMemoryBarrier toDst[COMP_BATCH_SIZE];
+    VkImageMemoryBarrier toRead[COMP_BATCH_SIZE];
+    for (uint32_t i = 0; i < count; i++)
+    {
+        toDst[i] = (VkImageMemoryBarrier){
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .image            = engine->compTiles[i].handle,
+            .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .subresourceRange = range,
+            .srcAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+            .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+        toRead[i] = (VkImageMemoryBarrier){
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .image            = engine->compTiles[i].handle,
+            .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .subresourceRange = range,
+            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT};
+    }
 
-    VkImageSubresourceRange subResRange = {
-        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-        .baseArrayLayer = 0,
-        .baseMipLevel   = 0,
-        .levelCount     = 1,
-        .layerCount     = 1,
-    };
+    for (uint32_t y = 0; y < size; y += tile)
+    {
+        for (uint32_t x = 0; x < size; x += tile)
+        {
+            if (count)
+                vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                                     NULL, count, toDst);
 
-    VkClearColorValue clearColor = {
-        .float32[0] = 0,
-        .float32[1] = 0,
-        .float32[2] = 0,
-        .float32[3] = 0,
-    };
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const VkBufferImageCopy region = {
+                    .bufferOffset = batch->buffers[i]->offset +
+                                    ((VkDeviceSize)y * size + x) * texelSize,
+                    .bufferRowLength   = size,
+                    .bufferImageHeight = tile,
+                    .imageSubresource  = {.aspectMask =
+                                              VK_IMAGE_ASPECT_COLOR_BIT,
+                                          .layerCount = 1},
+                    .imageExtent       = {tile, tile, 1}};
+
+                vkCmdCopyBufferToImage(cmdBuf, batch->buffers[i]->buffer,
+                                       engine->compTiles[i].handle,
+                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                       &region);
+            }
 
-    VkImageMemoryBarrier barriers[] = {
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageA.handle,
-         .oldLayout        = engine->imageA.layout,
-         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = 0,
-         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT},
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageB.handle,
-         .oldLayout        = engine->imageB.layout,
-         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = 0,
-         .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT},
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageC.handle,
-         .oldLayout        = engine->imageC.layout,
-         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = 0,
-         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT},
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageD.handle,
-         .oldLayout        = engine->imageD.layout,
-         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = 0,
-         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT}};
+            if (count)
+                vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                                     NULL, 0, NULL, count, toRead);
 
-    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
-                         LEN(barriers), barriers);
+            batch->pc.tileOrigin[0] = x;
+            batch->pc.tileOrigin[1] = y;
+            batch->pc.tileMin[0]    = (float)x / size;
+            batch->pc.tileMin[1]    = (float)y / size;
+            batch->pc.tileMax[0]    = (float)(x + tile) / size;
+            batch->pc.tileMax[1]    = (float)(y + tile) / size;
 
-    obdn_CmdCopyImageToBuffer(cmd.buffer, 0, &engine->imageB, prevLayerBuffer);
+            const VkRenderPassBeginInfo rpass = {
+                .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .renderArea  = {{x, y}, {tile, tile}},
+                .renderPass  = engine->singleCompositeRenderPass,
+                .framebuffer = batch->framebuffer,
+            };
 
-    vkCmdClearColorImage(cmd.buffer, engine->imageC.handle,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
-                         &subResRange);
-    vkCmdClearColorImage(cmd.buffer, engine->imageD.handle,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
-                         &subResRange);
+            vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
 
-    VkImageMemoryBarrier barriers0[] = {
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageC.handle,
-         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-         .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageD.handle,
-         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-         .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT}};
+            vkCmdBindDescriptorSets(
+                cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                engine->pipelineLayout, DESC_SET_COMP, 1,
+                &engine->description.descriptorSets[DESC_SET_COMP], 0, NULL);
 
-    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              batch->pipeline);
+
+            vkCmdPushConstants(cmdBuf, engine->pipelineLayout,
+                               PAINT_PC_STAGES, 0, sizeof(batch->pc),
+                               &batch->pc);
+
+            vkCmdDraw(cmdBuf, 6, 1, 0, 0);
+
+            vkCmdEndRenderPass(cmdBuf);
+        }
+    }
+
+    batch->pc.count = 0;
+}
+
+static uint32_t
+unorm8(float f)
+{
+    return MIN(MAX(f, 0.0), 1.0) * 255.0 + 0.5;
+}
+
+// queues a layer's worth of texels, drawing the batch once it's full
+static void
+batchLayer(Engine* engine, const VkCommandBuffer cmdBuf, CompBatch* batch,
+           const BufferRegion* buffer, const CompPushConstants* pc)
+{
+    // a layer the swap file can't give back is left out
+    if (pc->opacity == 0.0 || !buffer)
+        return;
+
+    const uint32_t opacity = MIN(MAX(pc->opacity, 0.0), 1.0) * 65535.0 + 0.5;
+    batch->buffers[batch->pc.count]   = buffer;
+    batch->pc.layers[batch->pc.count] = (CompBatchLayer){
+        .mode = pc->blendMode | pc->mask << 8 | opacity << 16,
+        .fill = unorm8(pc->fill[0]) | unorm8(pc->fill[1]) << 8 |
+                unorm8(pc->fill[2]) << 16 | 0xFFu << 24};
+    batch->pc.flags = pc->coverage ? COMP_BATCH_COVERAGE : 0;
+
+    if (++batch->pc.count == COMP_BATCH_SIZE)
+        drawCompBatch(engine, cmdBuf, batch);
+}
+
+// divides the composite in the group image behind framebuffer by its 
+// alpha, so it can be copied out to a cache or layer and read back as a 
+// straight source like any other
+static void
+unpremultiplyGroupImage(Engine* engine, const VkCommandBuffer cmdBuf,
+                        VkFramebuffer framebuffer, VkPipeline pipeline)
+{
+    if (formatInfo(engine)->coverage)
+        return;
+    CompBatch batch = {.framebuffer = framebuffer,
+                       .pipeline    = pipeline,
+                       .pc.flags    = COMP_BATCH_UNPREMULTIPLY};
+    drawCompBatch(engine, cmdBuf, &batch);
+}
+
+static CompPushConstants
+groupComp(const Engine* engine, const Dali_LayerGroup* group)
+{
+    return (CompPushConstants){
+        .blendMode = group->blendMode,
+        .opacity   = group->visible ? group->opacity : 0.0,
+        .coverage  = formatInfo(engine)->coverage};
+}
+
+static bool
+groupWithin(const Dali_LayerStack* stack, Dali_LayerGroupId g,
+            Dali_LayerGroupId outer)
+{
+    for (; g != DALI_LAYER_GROUP_NONE; g = stack->groups[g].parent)
+    {
+        if (g == outer)
+            return true;
+    }
+    return false;
+}
+
+// the outermost group holding l but not the active layer, unless it's in 
+// the isolated group. its cache stands in for all of its layers.
+static Dali_LayerGroupId
+cachedGroupOf(const Engine* engine, const Dali_LayerStack* stack,
+              Dali_LayerId l)
+{
+    Dali_LayerGroupId unit = DALI_LAYER_GROUP_NONE;
+    for (Dali_LayerGroupId g = stack->layers[l].group;
+         g != DALI_LAYER_GROUP_NONE &&
+         (!layer_GroupContains(stack, g, engine->curLayerId) ||
+          groupWithin(stack, g, engine->isolatedGroup));
+         g = stack->groups[g].parent)
+        unit = g;
+    return unit;
+}
+
+// whether a group holding the active layer can be passed through, its 
+// opacity pushed down onto its layers, without changing what it looks 
+// like: only a normal group at full opacity whose layers and child groups 
+// all blend normally.
+static bool
+passesThrough(const Dali_LayerStack* stack, Dali_LayerGroupId g)
+{
+    const Dali_LayerGroup* group = &stack->groups[g];
+    if (!group->visible)
+        return true;
+    if (group->blendMode != DALI_BLEND_MODE_NORMAL || group->opacity != 1.0)
+        return false;
+    for (Dali_LayerGroupId c = 0; c < stack->groupCount; c++)
+    {
+        const Dali_LayerGroup* child = &stack->groups[c];
+        if (child->parent == g && child->visible &&
+            child->blendMode != DALI_BLEND_MODE_NORMAL)
+            return false;
+    }
+    Dali_LayerId first, end;
+    layer_GroupRange(stack, g, &first, &end);
+    for (Dali_LayerId l = first; l < end; l++)
+    {
+        const Dali_Layer* layer = &stack->layers[l];
+        if (layer->group == g && layer->visible &&
+            layer->blendMode != DALI_BLEND_MODE_NORMAL)
+            return false;
+    }
+    return true;
+}
+
+// whether the units compositeLayers would lay down above the active layer 
+// can be flattened into D and laid over with a plain over. a unit with any 
+// other blend mode has to see what's under it, which is B while it's 
+// painted.
+static bool
+foregroundFlattens(const Engine* engine, const Dali_LayerStack* stack)
+{
+    for (int l = engine->curLayerId + 1; l < stack->layerCount;)
+    {
+        const Dali_LayerGroupId g = cachedGroupOf(engine, stack, l);
+        if (g != DALI_LAYER_GROUP_NONE)
+        {
+            const Dali_LayerGroup* group = &stack->groups[g];
+            if (group->visible && group->blendMode != DALI_BLEND_MODE_NORMAL)
+                return false;
+            Dali_LayerId lo, hi;
+            layer_GroupRange(stack, g, &lo, &hi);
+            l = hi;
+        }
+        else
+        {
+            const Dali_Layer* layer = &stack->layers[l];
+            if (layer->visible && layer->blendMode != DALI_BLEND_MODE_NORMAL)
+                return false;
+            l++;
+        }
+    }
+    return true;
+}
+
+// picks how frames are composited around the active layer; see liveComp
+static void
+updateLiveComp(Engine* engine, const Dali_LayerStack* stack)
+{
+    engine->isolatedGroup = DALI_LAYER_GROUP_NONE;
+    for (Dali_LayerGroupId g = stack->layers[engine->curLayerId].group;
+         g != DALI_LAYER_GROUP_NONE; g = stack->groups[g].parent)
+    {
+        if (!passesThrough(stack, g))
+            engine->isolatedGroup = g;
+    }
+    engine->liveStart = engine->curLayerId;
+    if (engine->isolatedGroup != DALI_LAYER_GROUP_NONE)
+    {
+        Dali_LayerId end;
+        layer_GroupRange(stack, engine->isolatedGroup, &engine->liveStart,
+                         &end);
+    }
+    engine->liveComp = engine->isolatedGroup != DALI_LAYER_GROUP_NONE ||
+                       !foregroundFlattens(engine, stack);
+}
+
+// the buffer layer l is composited from. while activeSource is set the 
+// active layer comes from there, a mask's coverage expanded into alpha.
+static const BufferRegion*
+compSource(const Engine* engine, Dali_LayerStack* stack, Dali_LayerId l,
+           CompPushConstants* pc)
+{
+    if (!engine->activeSource || l != engine->curLayerId)
+        return layer_SourceBuffer(stack, l);
+    if (pc->mask)
+        pc->mask = 4;
+    return engine->activeSource;
+}
+
+// blends layers [first, end) into the group image behind framebuffer. 
+// groups off the active layer's path go in whole from their caches; the 
+// ones on it are passed through, scaling what they hold by their opacity.
+static void
+compositeLayers(Engine* engine, Dali_LayerStack* stack,
+                const VkCommandBuffer cmdBuf, int first, int end,
+                VkFramebuffer framebuffer, VkPipeline pipeline)
+{
+    CompBatch batch = {.framebuffer = framebuffer, .pipeline = pipeline};
+    for (int l = first; l < end;)
+    {
+        const Dali_LayerGroupId g = cachedGroupOf(engine, stack, l);
+        if (g != DALI_LAYER_GROUP_NONE)
+        {
+            Dali_LayerGroup*  group = &stack->groups[g];
+            CompPushConstants pc    = groupComp(engine, group);
+            pc.opacity *= layer_PathOpacity(stack, group->parent);
+            batchLayer(engine, cmdBuf, &batch, &group->cache, &pc);
+            Dali_LayerId lo, hi;
+            layer_GroupRange(stack, g, &lo, &hi);
+            l = hi;
+        }
+        else
+        {
+            Dali_Layer*       layer = dali_GetLayer(stack, l);
+            CompPushConstants pc    = layerComp(engine, layer);
+            pc.opacity *= layer_PathOpacity(stack, layer->group);
+            // before the source, which would unpack a hidden layer
+            if (pc.opacity != 0.0)
+                batchLayer(engine, cmdBuf, &batch,
+                           compSource(engine, stack, l, &pc), &pc);
+            l++;
+        }
+    }
+    drawCompBatch(engine, cmdBuf, &batch);
+}
+
+// flattens a group into its cache, refreshing stale groups inside it 
+// first. scratch is the cleared image behind framebuffer and is left 
+// cleared.
+static void
+refreshGroup(Engine* engine, Dali_LayerStack* stack,
+             const VkCommandBuffer cmdBuf, Dali_LayerGroupId g, Image* scratch,
+             VkFramebuffer framebuffer, VkPipeline pipeline)
+{
+    // hidden ones stay stale until they show
+    for (Dali_LayerGroupId c = 0; c < stack->groupCount; c++)
+    {
+        if (stack->groups[c].parent == g && stack->groups[c].stale &&
+            groupComp(engine, &stack->groups[c]).opacity != 0.0)
+            refreshGroup(engine, stack, cmdBuf, c, scratch, framebuffer,
+                         pipeline);
+    }
+
+    CompBatch batch = {.framebuffer = framebuffer, .pipeline = pipeline};
+    Dali_LayerId first, end;
+    layer_GroupRange(stack, g, &first, &end);
+    for (Dali_LayerId l = first; l < end;)
+    {
+        if (stack->layers[l].group == g)
+        {
+            CompPushConstants pc = layerComp(engine, &stack->layers[l]);
+            if (pc.opacity != 0.0)
+                batchLayer(engine, cmdBuf, &batch,
+                           compSource(engine, stack, l, &pc), &pc);
+            l++;
+            continue;
+        }
+        Dali_LayerGroupId c = stack->layers[l].group;
+        while (stack->groups[c].parent != g)
+            c = stack->groups[c].parent;
+        const CompPushConstants pc = groupComp(engine, &stack->groups[c]);
+        batchLayer(engine, cmdBuf, &batch, &stack->groups[c].cache, &pc);
+        Dali_LayerId lo;
+        layer_GroupRange(stack, c, &lo, &l);
+    }
+    drawCompBatch(engine, cmdBuf, &batch);
+    unpremultiplyGroupImage(engine, cmdBuf, framebuffer, pipeline);
+
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
+
+    const VkImageMemoryBarrier toSrc = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = scratch->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &toSrc);
+
+    obdn_CmdCopyImageToBuffer(cmdBuf, 0, scratch, &stack->groups[g].cache);
+
+    const VkImageMemoryBarrier toDst = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = scratch->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &toDst);
+
+    const VkClearColorValue clearColor = {0};
+    vkCmdClearColorImage(cmdBuf, scratch->handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+                         &range);
+
+    const VkImageMemoryBarrier toAttachment = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = scratch->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
-                         NULL, 0, NULL, LEN(barriers0), barriers0);
+                         NULL, 0, NULL, 1, &toAttachment);
 
-    engine->curLayerId = newLayerId;
+    stack->groups[g].stale = false;
+}
+
+// refreshes the stale caches compositeLayers will read for [first, end). 
+// only the path from a changed layer up to the first cached group is 
+// redone; everything else comes from the caches as they are.
+static void
+refreshGroupCaches(Engine* engine, Dali_LayerStack* stack,
+                   const VkCommandBuffer cmdBuf, int first, int end,
+                   Image* scratch, VkFramebuffer framebuffer,
+                   VkPipeline pipeline)
+{
+    for (int l = first; l < end;)
+    {
+        const Dali_LayerGroupId g = cachedGroupOf(engine, stack, l);
+        if (g == DALI_LAYER_GROUP_NONE)
+        {
+            l++;
+            continue;
+        }
+        const float opacity = groupComp(engine, &stack->groups[g]).opacity *
+                              layer_PathOpacity(stack, stack->groups[g].parent);
+        if (stack->groups[g].stale && opacity != 0.0)
+            refreshGroup(engine, stack, cmdBuf, g, scratch, framebuffer,
+                         pipeline);
+        Dali_LayerId lo, hi;
+        layer_GroupRange(stack, g, &lo, &hi);
+        l = hi;
+    }
+}
+
+// takes a group image from shader reads to a cleared color attachment
+static void
+clearGroupImage(const VkCommandBuffer cmdBuf, const Image* group)
+{
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
+
+    const VkClearColorValue clearColor = {0};
+
+    const VkImageMemoryBarrier toTransfer = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = group->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .subresourceRange = range,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         1, &toTransfer);
+
+    vkCmdClearColorImage(cmdBuf, group->handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+                         &range);
+
+    const VkImageMemoryBarrier toAttachment = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = group->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
+                         NULL, 0, NULL, 1, &toAttachment);
+}
+
+// recomposites one cached group after a property of a layer in it 
+// changed. the active layer and the other group are left alone.
+static void
+rebuildLayerGroup(Engine* engine, Dali_LayerStack* stack, bool background)
+{
+    Image* group = background ? &engine->imageC : &engine->imageD;
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    clearGroupImage(cmd.buffer, group);
+
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
+
+    const int first = background ? 0 : engine->curLayerId + 1;
+    const int end = background ? engine->liveStart : dali_GetLayerCount(stack);
+    const VkFramebuffer framebuffer = background ? engine->backgroundFrameBuffer
+                                                 : engine->foregroundFrameBuffer;
+    const VkPipeline pipeline =
+        engine->compPipelines[background ? PIPELINE_COMP_BACKGROUND
+                                         : PIPELINE_COMP_FOREGROUND];
+
+    refreshGroupCaches(engine, stack, cmd.buffer, first, end, group,
+                       framebuffer, pipeline);
+
+    compositeLayers(engine, stack, cmd.buffer, first, end, framebuffer,
+                    pipeline);
+
+    const VkImageMemoryBarrier toRead = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = group->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT};
+
+    vkCmdPipelineBarrier(cmd.buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &toRead);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+}
+
+// copies B to or from a buffer outside of a frame and waits for it
+static void
+copyImageB(Engine* engine, BufferRegion* buffer, bool toBuffer)
+{
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
+
+    const VkImageLayout transferLayout =
+        toBuffer ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                 : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    const VkAccessFlags transferAccess =
+        toBuffer ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    const VkImageMemoryBarrier toTransfer = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageB.handle,
+        .oldLayout        = engine->imageB.layout,
+        .newLayout        = transferLayout,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask    = transferAccess};
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &toTransfer);
+
+    if (toBuffer)
+        obdn_CmdCopyImageToBuffer(cmd.buffer, 0, &engine->imageB, buffer);
+    else
+        obdn_CmdCopyBufferToImage(cmd.buffer, 0, buffer, &engine->imageB);
+
+    const VkImageMemoryBarrier toPrev = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageB.handle,
+        .oldLayout        = transferLayout,
+        .newLayout        = engine->imageB.layout,
+        .subresourceRange = range,
+        .srcAccessMask    = transferAccess,
+        .dstAccessMask    = 0};
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &toPrev);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+}
+
+// copies the active layer out of B into its buffer, packing a mask layer's 
+// coverage back into its channel. it has to land before the layer is 
+// composited from there, so this waits.
+static void
+storeActiveLayer(Engine* engine, Dali_LayerStack* stack)
+{
+    if (dali_IsMaskLayer(stack, engine->curLayerId))
+    {
+        copyImageB(engine, &stack->backBuffer, true);
+        layer_PackMask(stack, engine->curLayerId, stack->backBuffer.hostData);
+    }
+    else
+        copyImageB(engine, layer_OverwriteBuffer(stack, engine->curLayerId),
+                   true);
+}
+
+// the other way, after something other than painting changed the buffer
+static void
+loadActiveLayer(Engine* engine, Dali_LayerStack* stack)
+{
+    if (dali_IsMaskLayer(stack, engine->curLayerId))
+    {
+        layer_ExpandMask(stack, engine->curLayerId, stack->frontBuffer.hostData);
+        copyImageB(engine, &stack->frontBuffer, false);
+    }
+    else
+    {
+        BufferRegion* buffer = layer_Buffer(stack, engine->curLayerId);
+        if (!buffer)
+        {
+            hell_Print("Could not read layer %d back from the swap file\n",
+                       engine->curLayerId);
+            return;
+        }
+        copyImageB(engine, buffer, false);
+    }
+}
+
+static void
+onLayerChange(Engine* engine, Dali_LayerStack* stack, Dali_LayerId newLayerId)
+{
+    hell_DebugPrint(PAINT_DEBUG_TAG_PAINT, "Begin\n");
+
+    const bool prevIsMask = dali_IsMaskLayer(stack, engine->curLayerId);
+    if (prevIsMask)
+        storeActiveLayer(engine, stack);
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    BufferRegion* prevLayerBuffer =
+        prevIsMask ? NULL : layer_OverwriteBuffer(stack, engine->curLayerId);
+
+    VkImageSubresourceRange subResRange = {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseArrayLayer = 0,
+        .baseMipLevel   = 0,
+        .levelCount     = 1,
+        .layerCount     = 1,
+    };
+
+    VkClearColorValue clearColor = {
+        .float32[0] = 0,
+        .float32[1] = 0,
+        .float32[2] = 0,
+        .float32[3] = 0,
+    };
+
+    VkImageMemoryBarrier barriers[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageA.handle,
+         .oldLayout        = engine->imageA.layout,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = 0,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageB.handle,
+         .oldLayout        = engine->imageB.layout,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = 0,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageC.handle,
+         .oldLayout        = engine->imageC.layout,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = 0,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageD.handle,
+         .oldLayout        = engine->imageD.layout,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = 0,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT}};
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         LEN(barriers), barriers);
+
+    if (!prevIsMask)
+        obdn_CmdCopyImageToBuffer(cmd.buffer, 0, &engine->imageB,
+                                  prevLayerBuffer);
+
+    vkCmdClearColorImage(cmd.buffer, engine->imageC.handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+                         &subResRange);
+    vkCmdClearColorImage(cmd.buffer, engine->imageD.handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+                         &subResRange);
+
+    VkImageMemoryBarrier barriers0[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageC.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageD.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT}};
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
+                         NULL, 0, NULL, LEN(barriers0), barriers0);
+
+    engine->curLayerId = newLayerId;
+    updateLiveComp(engine, stack);
+
+    const int layerCount = dali_GetLayerCount(stack);
+
+    refreshGroupCaches(engine, stack, cmd.buffer, 0, engine->liveStart,
+                       &engine->imageC, engine->backgroundFrameBuffer,
+                       engine->compPipelines[PIPELINE_COMP_BACKGROUND]);
+
+    compositeLayers(engine, stack, cmd.buffer, 0, engine->liveStart,
+                    engine->backgroundFrameBuffer,
+                    engine->compPipelines[PIPELINE_COMP_BACKGROUND]);
+
+    refreshGroupCaches(engine, stack, cmd.buffer, engine->curLayerId + 1,
+                       layerCount, &engine->imageD,
+                       engine->foregroundFrameBuffer,
+                       engine->compPipelines[PIPELINE_COMP_FOREGROUND]);
+
+    compositeLayers(engine, stack, cmd.buffer, engine->curLayerId + 1,
+                    layerCount, engine->foregroundFrameBuffer,
+                    engine->compPipelines[PIPELINE_COMP_FOREGROUND]);
+
+    VkImageMemoryBarrier barrier1 = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageB.handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .subresourceRange = subResRange,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &barrier1);
+
+    BufferRegion* layerBuffer = &stack->frontBuffer;
+    if (dali_IsMaskLayer(stack, engine->curLayerId))
+    {
+        // painted expanded; only the alpha goes back
+        layer_ExpandMask(stack, engine->curLayerId,
+                         stack->frontBuffer.hostData);
+    }
+    else
+        layerBuffer = layer_Buffer(stack, engine->curLayerId);
+    if (!layerBuffer)
+    {
+        // shown empty. the layer keeps its place on disk until painted on.
+        hell_Print("Could not read layer %d back from the swap file\n",
+                   engine->curLayerId);
+        memset(stack->frontBuffer.hostData, 0, stack->layerSize);
+        layerBuffer = &stack->frontBuffer;
+    }
+
+    obdn_CmdCopyBufferToImage(cmd.buffer, 0, layerBuffer, &engine->imageB);
+
+    VkImageMemoryBarrier barriers2[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageA.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+         .dstAccessMask    = 0},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageB.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = VK_ACCESS_MEMORY_READ_BIT,
+         .dstAccessMask    = 0},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageC.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
+         .dstAccessMask    = 0},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageD.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .subresourceRange = subResRange,
+         .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
+         .dstAccessMask    = 0}};
+
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
+                         NULL, LEN(barriers), barriers2);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+
+    engine->snapshotStale = true;
+
+    hell_DebugPrint(PAINT_DEBUG_TAG_PAINT, "End\n");
+}
+
+static void
+runUndoCommands(Engine* engine, const bool toHost /*vs fromHost*/, BufferRegion* bufferRegion)
+{
+    obdn_WaitForFence(engine->device, &engine->cmdAcquireImageTranferSource.fence);
+
+    obdn_ResetCommand(&engine->cmdReleaseImageTransferSource);
+    obdn_ResetCommand(&engine->cmdTranferImage);
+    obdn_ResetCommand(&engine->cmdAcquireImageTranferSource);
+
+    VkCommandBuffer cmdBuf = engine->cmdReleaseImageTransferSource.buffer;
+
+    obdn_BeginCommandBuffer(cmdBuf);
+
+    const VkImageSubresourceRange range = {.aspectMask =
+                                               VK_IMAGE_ASPECT_COLOR_BIT,
+                                           .baseMipLevel   = 0,
+                                           .levelCount     = 1,
+                                           .baseArrayLayer = 0,
+                                           .layerCount     = 1};
+
+    const VkImageLayout otherLayout =
+        toHost ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+               : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    const VkAccessFlags otherAccessMask =
+        toHost ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkImageMemoryBarrier imgBarrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext               = NULL,
+        .srcAccessMask       = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+        .dstAccessMask       = 0, /* ignored for this batter */
+        .oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout           = otherLayout,
+        .srcQueueFamilyIndex = engine->graphicsQueueFamilyIndex,
+        .dstQueueFamilyIndex = engine->transferQueueFamilyIndex,
+        .image               = engine->imageB.handle,
+        .subresourceRange    = range};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
+                         &imgBarrier);
+
+    obdn_EndCommandBuffer(cmdBuf);
+
+    cmdBuf = engine->cmdTranferImage.buffer;
+
+    obdn_BeginCommandBuffer(cmdBuf);
+
+// if is where the first validation message occurs
+    imgBarrier.srcAccessMask = 0;
+    imgBarrier.dstAccessMask = otherAccessMask;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
+                         &imgBarrier);
+
+    if (toHost)
+        obdn_CmdCopyImageToBuffer(cmdBuf, 0, &engine->imageB, bufferRegion);
+    else
+        obdn_CmdCopyBufferToImage(cmdBuf, 0, bufferRegion, &engine->imageB);
+
+    imgBarrier.srcAccessMask       = otherAccessMask;
+    imgBarrier.dstAccessMask       = 0; //again, not used on this half of the ownership tranfer but validation layers complain
+    imgBarrier.oldLayout           = otherLayout;
+    imgBarrier.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imgBarrier.srcQueueFamilyIndex = engine->transferQueueFamilyIndex;
+    imgBarrier.dstQueueFamilyIndex = engine->graphicsQueueFamilyIndex;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
+                         &imgBarrier);
+
+    obdn_EndCommandBuffer(cmdBuf);
+
+    cmdBuf = engine->cmdAcquireImageTranferSource.buffer;
+
+    obdn_BeginCommandBuffer(cmdBuf);
+
+    imgBarrier.srcAccessMask = 0; // will be ignored 
+    imgBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
+                         &imgBarrier);
+
+    obdn_EndCommandBuffer(cmdBuf);
+
+    obdn_SubmitGraphicsCommand(
+        engine->instance, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, NULL, 1,
+        &engine->cmdReleaseImageTransferSource.semaphore, VK_NULL_HANDLE,
+        engine->cmdReleaseImageTransferSource.buffer);
+
+    obdn_SubmitTransferCommand(engine->instance, 0,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               &engine->cmdReleaseImageTransferSource.semaphore,
+                               VK_NULL_HANDLE, &engine->cmdTranferImage);
+
+    obdn_SubmitGraphicsCommand(
+        engine->instance, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 1,
+        &engine->cmdTranferImage.semaphore, 1,
+        &engine->cmdAcquireImageTranferSource.semaphore,
+        engine->cmdAcquireImageTranferSource.fence, engine->cmdAcquireImageTranferSource.buffer);
+}
+
+static void
+backupLayer(Engine* engine, Dali_UndoManager* undo)
+{
+    runUndoCommands(engine, true, dali_GetNextUndoBuffer(undo));
+    hell_DebugPrint(DTAG, "layer backed up\n");
+}
+
+static bool
+undo(Engine* engine, Dali_UndoManager* undo)
+{
+    hell_DebugPrint(DTAG, "undo\n");
+    BufferRegion* buf = dali_GetLastUndoBuffer(undo);
+    if (!buf)
+        return false; // nothing to undo
+    runUndoCommands(engine, false, buf);
+    engine->snapshotStale = true;
+    return true;
+}
+
+static void
+copyBufferRegion(const VkCommandBuffer cmdBuf, const BufferRegion* src,
+                 const BufferRegion* dst)
+{
+    const VkBufferCopy region = {
+        .srcOffset = src->offset, .dstOffset = dst->offset, .size = src->size};
+    vkCmdCopyBuffer(cmdBuf, src->buffer, dst->buffer, 1, &region);
+}
+
+// orders the transfers recorded so far before anything after
+static void
+transferBarrier(const VkCommandBuffer cmdBuf)
+{
+    const VkMemoryBarrier barrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT |
+                         VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT |
+                         VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         NULL, 0, NULL);
+}
+
+// copies a group image composited into from a cleared one out to a 
+// layer's buffer and hands it back to shader reads
+static void
+copyGroupImage(const VkCommandBuffer cmdBuf, const Image* group,
+               BufferRegion* dst)
+{
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
+
+    const VkImageMemoryBarrier toSrc = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = group->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &toSrc);
+
+    obdn_CmdCopyImageToBuffer(cmdBuf, 0, group, dst);
+
+    const VkImageMemoryBarrier toRead = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = group->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &toRead);
+}
+
+// sets every texel of a layer's buffer. the color is cleared into a tile 
+// image, which is copied over the layer a tile at a time.
+static void
+fillLayerBuffer(Engine* engine, const VkCommandBuffer cmdBuf,
+                const BufferRegion* buffer, const float color[4])
+{
+    const Image*       tile      = &engine->compTiles[0];
+    const uint32_t     size      = engine->textureSize;
+    const uint32_t     tileSize  = engine->compTileSize;
+    const VkDeviceSize texelSize = formatInfo(engine)->texelSize;
+
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
+
+    const VkImageMemoryBarrier toDst = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = tile->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &toDst);
+
+    // coverage formats keep the alpha in r
+    const VkClearColorValue clearColor =
+        formatInfo(engine)->coverage
+            ? (VkClearColorValue){.float32 = {color[3]}}
+            : (VkClearColorValue){
+                  .float32 = {color[0], color[1], color[2], color[3]}};
+
+    vkCmdClearColorImage(cmdBuf, tile->handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+                         &range);
+
+    const VkImageMemoryBarrier toSrc = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = tile->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &toSrc);
+
+    for (uint32_t y = 0; y < size; y += tileSize)
+    {
+        for (uint32_t x = 0; x < size; x += tileSize)
+        {
+            const VkBufferImageCopy region = {
+                .bufferOffset =
+                    buffer->offset + ((VkDeviceSize)y * size + x) * texelSize,
+                .bufferRowLength   = size,
+                .bufferImageHeight = tileSize,
+                .imageSubresource  = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                      .layerCount = 1},
+                .imageExtent       = {tileSize, tileSize, 1}};
+
+            vkCmdCopyImageToBuffer(cmdBuf, tile->handle,
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   buffer->buffer, 1, &region);
+        }
+    }
+
+    const VkImageMemoryBarrier toRead = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = tile->handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &toRead);
+}
+
+// clears or fills the active layer. a mask layer's channel is written on 
+// the host; nothing on the gpu is using its set between frames.
+static void
+fillLayer(Engine* engine, Dali_LayerStack* stack, const LayerOp* op)
+{
+    const Dali_LayerId id    = stack->activeLayer;
+    Dali_Layer*        layer = dali_GetLayer(stack, id);
+    layer_MarkAncestorsStale(stack, layer->group);
+
+    if (layer->isMask)
+    {
+        if (op->type == LAYER_OP_FILL)
+        {
+            for (int i = 0; i < 3; i++)
+                layer->fill[i] = op->color[i];
+        }
+        layer_FillMask(stack, id,
+                       op->type == LAYER_OP_FILL ? unorm8(op->color[3]) : 0);
+        return;
+    }
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    const BufferRegion* buffer = layer_OverwriteBuffer(stack, id);
+    if (op->type == LAYER_OP_FILL)
+        fillLayerBuffer(engine, cmd.buffer, buffer, op->color);
+    else
+        vkCmdFillBuffer(cmd.buffer, buffer->buffer, buffer->offset,
+                        buffer->size, 0);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+}
+
+// layer_Buffer on every layer in [first, end) that isn't a mask, so a 
+// whole-layer edit can't get halfway before finding one the swap file 
+// lost. they're in host or device memory after.
+static bool
+layersReadable(Dali_LayerStack* stack, Dali_LayerId first, Dali_LayerId end)
+{
+    for (Dali_LayerId l = first; l < end; l++)
+    {
+        if (!dali_IsMaskLayer(stack, l) && !layer_Buffer(stack, l))
+        {
+            hell_Print("Could not read layer %d back from the swap file\n", l);
+            return false;
+        }
+    }
+    return true;
+}
+
+// copies the active layer to a new one on top, which becomes active
+static void
+duplicateLayer(Engine* engine, Dali_LayerStack* stack, Dali_UndoManager* u)
+{
+    const Dali_LayerId src = stack->activeLayer;
+    if (dali_IsMaskLayer(stack, src))
+    {
+        hell_Print("Mask layers can't be duplicated\n");
+        return;
+    }
+    if (!layersReadable(stack, src, src + 1))
+        return;
+    const int dst = dali_CreateLayer(stack);
+    if (dst == -1)
+    {
+        hell_Print("Out of layers\n");
+        return;
+    }
+    const Dali_Layer* orig = dali_GetLayer(stack, src);
+    Dali_Layer*       copy = dali_GetLayer(stack, dst);
+    copy->opacity   = orig->opacity;
+    copy->visible   = orig->visible;
+    copy->blendMode = orig->blendMode;
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    copyBufferRegion(cmd.buffer, layer_Buffer(stack, src),
+                     layer_Buffer(stack, dst));
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+
+    undo_PushLayerOp(u, stack, LAYER_OP_DUPLICATE, dst, 0);
+    stack->activeLayer = dst;
+}
+
+// lays the active layer over the one below in the background group image, 
+// which is rebuilt afterwards, and removes it
+static void
+mergeLayerDown(Engine* engine, Dali_LayerStack* stack, Dali_UndoManager* u)
+{
+    const Dali_LayerId src = stack->activeLayer;
+    if (src == 0)
+    {
+        hell_Print("No layer to merge down onto\n");
+        return;
+    }
+    const Dali_LayerId dst = src - 1;
+    if (dali_IsMaskLayer(stack, src) || dali_IsMaskLayer(stack, dst))
+    {
+        hell_Print("Mask layers can't be merged\n");
+        return;
+    }
+    if (!layersReadable(stack, dst, src + 1))
+        return;
+    // the journal forgets what the removal renumbers before the entry 
+    // for it goes in
+    undo_OnLayerRemoved(u, src);
+    LayerOpUndo*  op    = undo_PushLayerOp(u, stack, LAYER_OP_MERGE_DOWN, dst, 2);
+    op->removed         = 1;
+    Dali_Layer*   below = dali_GetLayer(stack, dst);
+    Dali_Layer*   above = dali_GetLayer(stack, src);
+    BufferRegion* belowBuffer = layer_Buffer(stack, dst);
+    BufferRegion* aboveBuffer = layer_Buffer(stack, src);
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    copyBufferRegion(cmd.buffer, belowBuffer, &op->saved[0]);
+    copyBufferRegion(cmd.buffer, aboveBuffer, &op->saved[1]);
+
+    transferBarrier(cmd.buffer);
+
+    clearGroupImage(cmd.buffer, &engine->imageC);
+
+    // the layer below goes down as it is. its own blend and opacity still 
+    // apply to the result.
+    const CompPushConstants base = {.blendMode = DALI_BLEND_MODE_NORMAL,
+                                    .opacity   = 1.0,
+                                    .coverage  = formatInfo(engine)->coverage};
+    const CompPushConstants pc   = layerComp(engine, above);
+
+    CompBatch batch = {
+        .framebuffer = engine->backgroundFrameBuffer,
+        .pipeline    = engine->compPipelines[PIPELINE_COMP_BACKGROUND]};
+    batchLayer(engine, cmd.buffer, &batch, belowBuffer, &base);
+    batchLayer(engine, cmd.buffer, &batch, aboveBuffer, &pc);
+    drawCompBatch(engine, cmd.buffer, &batch);
+    unpremultiplyGroupImage(engine, cmd.buffer, batch.framebuffer,
+                            batch.pipeline);
+
+    copyGroupImage(cmd.buffer, &engine->imageC, belowBuffer);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+
+    layer_MarkAncestorsStale(stack, below->group);
+    layer_RemoveLayer(stack, src);
+    stack->activeLayer = dst;
+}
+
+static Dali_LayerGroupId
+outermostGroupOf(const Dali_LayerStack* stack, Dali_LayerId l)
+{
+    Dali_LayerGroupId g = stack->layers[l].group;
+    while (g != DALI_LAYER_GROUP_NONE &&
+           stack->groups[g].parent != DALI_LAYER_GROUP_NONE)
+        g = stack->groups[g].parent;
+    return g;
+}
+
+// composites the whole stack into layer 0 through the background group 
+// image and removes the rest
+static void
+flattenLayers(Engine* engine, Dali_LayerStack* stack, Dali_UndoManager* u)
+{
+    if (dali_IsMaskLayer(stack, 0))
+    {
+        hell_Print("Can't flatten onto a mask layer\n");
+        return;
+    }
+    const int count = dali_GetLayerCount(stack);
+    if (!layersReadable(stack, 0, count))
+        return;
+    for (int l = count - 1; l > 0; l--)
+        undo_OnLayerRemoved(u, l);
+    LayerOpUndo* op = undo_PushLayerOp(u, stack, LAYER_OP_FLATTEN, 0, count);
+    op->removed     = count - 1;
+
+    const VkFramebuffer framebuffer = engine->backgroundFrameBuffer;
+    const VkPipeline    pipeline =
+        engine->compPipelines[PIPELINE_COMP_BACKGROUND];
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    for (int l = 0; l < count; l++)
+    {
+        if (dali_IsMaskLayer(stack, l))
+            layer_ReadMask(stack, l, op->saved[l].hostData);
+        else
+            copyBufferRegion(cmd.buffer, layer_Buffer(stack, l),
+                             &op->saved[l]);
+    }
+
+    transferBarrier(cmd.buffer);
+
+    clearGroupImage(cmd.buffer, &engine->imageC);
+
+    // top level groups go in from their caches, refreshed while the 
+    // target is still clear to serve as scratch
+    for (int l = 0; l < count;)
+    {
+        const Dali_LayerGroupId g = outermostGroupOf(stack, l);
+        if (g == DALI_LAYER_GROUP_NONE)
+        {
+            l++;
+            continue;
+        }
+        if (stack->groups[g].stale)
+            refreshGroup(engine, stack, cmd.buffer, g, &engine->imageC,
+                         framebuffer, pipeline);
+        Dali_LayerId lo, hi;
+        layer_GroupRange(stack, g, &lo, &hi);
+        l = hi;
+    }
+
+    CompBatch batch = {.framebuffer = framebuffer, .pipeline = pipeline};
+    for (int l = 0; l < count;)
+    {
+        const Dali_LayerGroupId g = outermostGroupOf(stack, l);
+        if (g != DALI_LAYER_GROUP_NONE)
+        {
+            const CompPushConstants pc = groupComp(engine, &stack->groups[g]);
+            batchLayer(engine, cmd.buffer, &batch, &stack->groups[g].cache,
+                       &pc);
+            Dali_LayerId lo, hi;
+            layer_GroupRange(stack, g, &lo, &hi);
+            l = hi;
+        }
+        else
+        {
+            const CompPushConstants pc =
+                layerComp(engine, dali_GetLayer(stack, l));
+            batchLayer(engine, cmd.buffer, &batch,
+                       layer_SourceBuffer(stack, l), &pc);
+            l++;
+        }
+    }
+    drawCompBatch(engine, cmd.buffer, &batch);
+    unpremultiplyGroupImage(engine, cmd.buffer, framebuffer, pipeline);
+
+    copyGroupImage(cmd.buffer, &engine->imageC,
+                   layer_Buffer(stack, 0));
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+
+    // out of every group first, so the groups go with the last of the rest
+    Dali_Layer* base = dali_GetLayer(stack, 0);
+    base->opacity    = 1.0;
+    base->visible    = true;
+    base->blendMode  = DALI_BLEND_MODE_NORMAL;
+    base->group      = DALI_LAYER_GROUP_NONE;
+    for (int l = count - 1; l > 0; l--)
+        layer_RemoveLayer(stack, l);
+    stack->activeLayer = 0;
+}
+
+// puts back what the last duplicate, merge or flatten overwrote
+static void
+undoLayerOp(Engine* engine, Dali_LayerStack* stack, Dali_UndoManager* u)
+{
+    LayerOpUndo* op = undo_PopLayerOp(u);
+    if (!op)
+    {
+        hell_Print("No layer op to undo!\n");
+        return;
+    }
+
+    const int count = dali_GetLayerCount(stack);
+    if (op->type == LAYER_OP_DUPLICATE)
+    {
+        if (op->first != count - 1)
+            hell_Print("The duplicate is no longer on top. Can't undo.\n");
+        else
+        {
+            layer_RemoveLayer(stack, op->first);
+            undo_OnLayerRemoved(u, op->first);
+        }
+    }
+    else if (count != op->layerCount - op->removed)
+        hell_Print("Layers were added or removed since. Can't undo.\n");
+    else
+    {
+        for (int i = op->count - op->removed; i < op->count; i++)
+        {
+            layer_InsertLayer(stack, op->first + i, &op->layers[i]);
+            undo_OnLayerInserted(u, op->first + i);
+        }
+
+        Obdn_Command cmd =
+            obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+        obdn_BeginCommandBuffer(cmd.buffer);
+
+        for (int i = 0; i < op->count; i++)
+        {
+            if (dali_IsMaskLayer(stack, op->first + i))
+                layer_WriteMask(stack, op->first + i, op->saved[i].hostData);
+            else
+                copyBufferRegion(cmd.buffer, &op->saved[i],
+                                 layer_OverwriteBuffer(stack, op->first + i));
+        }
+
+        obdn_EndCommandBuffer(cmd.buffer);
+
+        obdn_SubmitAndWait(&cmd, 0);
+
+        obdn_DestroyCommand(cmd);
+
+        // the pixels may have changed tier since; they stay where they are
+        for (int i = 0; i < op->count; i++)
+        {
+            const Dali_Layer* now = &stack->layers[op->first + i];
+            op->layers[i].bufferRegion = now->bufferRegion;
+            op->layers[i].residency    = now->residency;
+            op->layers[i].swapSlot     = now->swapSlot;
+            op->layers[i].lastUse      = now->lastUse;
+            op->layers[i].usedAt       = now->usedAt;
+            op->layers[i].packed       = now->packed;
+            op->layers[i].packedSize   = now->packedSize;
+        }
+        memcpy(&stack->layers[op->first], op->layers,
+               sizeof(Dali_Layer) * op->count);
+        layer_RestoreGroups(stack, op->groups, op->groupCount,
+                            op->layerGroups);
+    }
+    stack->activeLayer = MIN(op->activeLayer, dali_GetLayerCount(stack) - 1);
+    undo_FreeLayerOp(op);
+}
+
+static void
+deleteLayer(Dali_LayerStack* stack, Dali_UndoManager* u)
+{
+    if (dali_GetLayerCount(stack) == 1)
+    {
+        hell_Print("Can't delete the last layer\n");
+        return;
+    }
+    const Dali_LayerId id = stack->activeLayer;
+    layer_RemoveLayer(stack, id);
+    undo_OnLayerRemoved(u, id);
+}
+
+static void
+moveLayer(Dali_LayerStack* stack, Dali_UndoManager* u, Dali_LayerId to)
+{
+    if (to >= dali_GetLayerCount(stack))
+    {
+        hell_Print("No layer %d to move to\n", to);
+        return;
+    }
+    const Dali_LayerId from = stack->activeLayer;
+    layer_MoveLayer(stack, from, to);
+    undo_OnLayerMoved(u, from, to);
+}
+
+// runs the queued layer ops, after taking back the last one if asked. the 
+// layers' buffers are brought up to date first and B is reloaded from 
+// whichever layer ends up active; the layer change that follows rebuilds 
+// the groups around it.
+static void
+runLayerOps(Engine* engine, Dali_LayerStack* stack, Dali_UndoManager* u)
+{
+    storeActiveLayer(engine, stack);
+
+    if (u->dirt & UNDO_LAYER_OP_BIT)
+        undoLayerOp(engine, stack, u);
+
+    bool backup = false;
+    for (int i = 0; i < stack->layerOpCount; i++)
+    {
+        const LayerOp* op = &stack->layerOps[i];
+        switch (op->type)
+        {
+            case LAYER_OP_CLEAR:
+            case LAYER_OP_FILL:
+                fillLayer(engine, stack, op);
+                backup = true;
+                break;
+            case LAYER_OP_DUPLICATE:  duplicateLayer(engine, stack, u); break;
+            case LAYER_OP_MERGE_DOWN: mergeLayerDown(engine, stack, u); break;
+            case LAYER_OP_FLATTEN:    flattenLayers(engine, stack, u); break;
+            case LAYER_OP_DELETE:     deleteLayer(stack, u); break;
+            case LAYER_OP_MOVE:       moveLayer(stack, u, op->to); break;
+        }
+    }
+    stack->layerOpCount = 0;
+
+    // ids may have shifted under the active layer, so the undo manager 
+    // looks it up again
+    engine->curLayerId = stack->activeLayer;
+    loadActiveLayer(engine, stack);
+    stack->dirt |= LAYER_CHANGED_BIT;
+    dali_UpdateUndo(u, stack);
+    // clear and fill are kept like a stroke
+    if (backup)
+        stack->dirt |= LAYER_BACKUP_BIT;
+}
+
+static void
+updateView(Engine* engine, const Obdn_Scene* scene)
+{
+    UboMatrices* matrices = (UboMatrices*)engine->matrixRegion.hostData;
+    matrices->view        = obdn_GetCameraView(scene);
+    matrices->viewInv     = coal_Invert4x4(matrices->view); //TODO: replace with cam.xform
+}
+
+static void
+updateProj(Engine* engine, const Obdn_Scene* scene)
+{
+    UboMatrices* matrices = (UboMatrices*)engine->matrixRegion.hostData;
+    matrices->proj        = obdn_GetCameraProjection(scene);
+    matrices->projInv     = coal_Invert4x4(matrices->proj);
+}
+
+static void
+updateBrushColor(UboBrush* brush, float r, float g, float b)
+{
+    brush->r = r;
+    brush->g = g;
+    brush->b = b;
+}
+
+// the brush ubo as b's general settings would leave it
+static UboBrush
+nextBrushUbo(const Engine* engine, const Dali_Brush* b)
+{
+    UboBrush next = *(const UboBrush*)engine->brushRegion.hostData;
+    if (b->mode != PAINT_MODE_ERASE)
+        updateBrushColor(&next, b->r, b->g, b->b);
+    else
+        updateBrushColor(&next, 1, 1, 1); // must be white for erase to work
+    next.radius       = b->radius;
+    next.x            = b->x;
+    next.y            = b->y;
+    next.opacity      = b->opacity;
+    next.anti_falloff = (1.0 - b->falloff) * b->radius;
+    next.cloneSpace   = b->cloneSpace;
+    next.cloneOffsetX = b->cloneOffsetX;
+    next.cloneOffsetY = b->cloneOffsetY;
+    next.mirrors      = b->mirrors;
+    next.radialAxis   = b->radialAxis;
+    next.radialCount  = b->radialCount;
+    return next;
+}
+
+// whether a dab drawn now would come out differently under b's settings. 
+// the position doesn't count; each dab brings its own.
+static bool
+dabBrushChanged(const Engine* engine, const Dali_Brush* b)
+{
+    const UboBrush* cur  = (const UboBrush*)engine->brushRegion.hostData;
+    const UboBrush  next = nextBrushUbo(engine, b);
+    return cur->radius != next.radius || cur->r != next.r ||
+           cur->g != next.g || cur->b != next.b ||
+           cur->opacity != next.opacity ||
+           cur->anti_falloff != next.anti_falloff ||
+           cur->cloneSpace != next.cloneSpace ||
+           cur->cloneOffsetX != next.cloneOffsetX ||
+           cur->cloneOffsetY != next.cloneOffsetY ||
+           cur->mirrors != next.mirrors || cur->radialAxis != next.radialAxis ||
+           cur->radialCount != next.radialCount;
+}
+
+static bool
+paintModeSupported(const Engine* engine, Dali_PaintMode mode)
+{
+    switch (mode)
+    {
+    case PAINT_MODE_SMUDGE:
+    case PAINT_MODE_BLUR:
+    case PAINT_MODE_SHARPEN: return !formatInfo(engine)->coverage;
+    default: return true;
+    }
+}
+
+static void
+syncBrush(Engine* engine, const Dali_Brush* b)
+{
+    UboBrush* brush = (UboBrush*)engine->brushRegion.hostData;
+
+    if (b->dirt & BRUSH_PAINT_MODE_BIT && !paintModeSupported(engine, b->mode))
+    {
+        // the coverage raygens only know over, erase and clone
+        hell_Print("Smudge, blur and sharpen need a four channel texture. "
+                   "Keeping the current paint mode.\n");
+    }
+    else if (b->dirt & BRUSH_PAINT_MODE_BIT)
+    {
+        vkDeviceWaitIdle(engine->device);
+        destroyCompPipelines(engine);
+        initCompPipelines(engine, b->mode);
+        engine->paintMode = b->mode;
+        brush->mode       = b->mode;
+    }
+
+    if (b->dirt & BRUSH_GENERAL_BIT)
+    {
+        *brush = nextBrushUbo(engine, b);
+
+        engine->brushActive = b->active;
+
+        engine->prevBrushPos.x = engine->brushPos.x;
+        engine->prevBrushPos.y = engine->brushPos.y;
+        engine->brushPos.x     = b->x;
+        engine->brushPos.y     = b->y;
+        engine->brushSpacing   = b->spacing;
+        engine->brushAngle     = b->angle;
+        engine->brushAngleVariation = b->angleVariation;
+
+        engine->symmetryCopies = b->radialCount;
+        for (int axis = DALI_AXIS_X; axis <= DALI_AXIS_Z; axis++)
+            if (b->mirrors & (1 << axis))
+                engine->symmetryCopies *= 2;
+
+        engine->brushTip        = b->tip;
+        engine->brushTipSetSize = b->tipSetSize;
+    }
+}
+
+static void
+syncCloneSource(Engine* engine, Dali_LayerStack* stack, const Dali_Brush* b)
+{
+    const BufferRegion* source = NULL;
+    if (b->mode == PAINT_MODE_CLONE && b->cloneLayer != DALI_CLONE_LAYER_ACTIVE &&
+        b->cloneLayer != engine->curLayerId)
+    {
+        if (b->cloneLayer >= dali_GetLayerCount(stack))
+            hell_Print("Clone layer %d does not exist. Cloning from the active layer.\n", b->cloneLayer);
+        else if (dali_IsMaskLayer(stack, b->cloneLayer))
+            hell_Print("Clone layer %d is a mask layer. Cloning from the active layer.\n", b->cloneLayer);
+        else if (!(source = layer_Buffer(stack, b->cloneLayer)))
+            hell_Print("Clone layer %d could not be read back from the swap file. Cloning from the active layer.\n", b->cloneLayer);
+    }
+    const VkBuffer buffer = source ? source->buffer : VK_NULL_HANDLE;
+    const VkDeviceSize offset = source ? source->offset : 0;
+    if (buffer != engine->snapshotSource.buffer ||
+        offset != engine->snapshotSource.offset)
+    {
+        engine->snapshotSource = source ? *source : (BufferRegion){0};
+        engine->snapshotStale  = true;
+    }
+}
+
+static uint32_t
+packNormal(const float n[3])
+{
+    const float s = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    if (s == 0.0)
+        return 0x7fff0000; // degenerate triangle. decodes to +z
+    float x = n[0] / s;
+    float y = n[1] / s;
+    if (n[2] < 0.0)
+    {
+        const float ox = x;
+        x = (1.0 - fabsf(y)) * (ox >= 0.0 ? 1.0 : -1.0);
+        y = (1.0 - fabsf(ox)) * (y >= 0.0 ? 1.0 : -1.0);
+    }
+    const uint16_t sx = (uint16_t)(int16_t)roundf(x * 32767.0);
+    const uint16_t sy = (uint16_t)(int16_t)roundf(y * 32767.0);
+    return sx | (uint32_t)sy << 16;
+}
+
+// a prim is a canvas when one affine map takes its uvs to its positions. 
+// the map is solved from the first triangle with any uv area and checked 
+// against every vertex.
+static void
+detectCanvas(Engine* engine, const Vec2* uvs, const Vec3* pos,
+             const uint32_t* indices, uint32_t indexCount)
+{
+    engine->canvas = false;
+    for (uint32_t t = 0; t + 2 < indexCount; t += 3)
+    {
+        const uint32_t* i = indices + t;
+        const Vec2 a = {uvs[i[1]].x - uvs[i[0]].x, uvs[i[1]].y - uvs[i[0]].y};
+        const Vec2 b = {uvs[i[2]].x - uvs[i[0]].x, uvs[i[2]].y - uvs[i[0]].y};
+        const float det = a.x * b.y - a.y * b.x;
+        if (fabsf(det) < 1e-8)
+            continue;
+        const Vec3 e1 = coal_Sub_Vec3(pos[i[1]], pos[i[0]]);
+        const Vec3 e2 = coal_Sub_Vec3(pos[i[2]], pos[i[0]]);
+        engine->canvasU = coal_Scale_Vec3(1.0 / det,
+            coal_Sub_Vec3(coal_Scale_Vec3(b.y, e1), coal_Scale_Vec3(a.y, e2)));
+        engine->canvasV = coal_Scale_Vec3(1.0 / det,
+            coal_Sub_Vec3(coal_Scale_Vec3(a.x, e2), coal_Scale_Vec3(b.x, e1)));
+        engine->canvasOrigin = coal_Sub_Vec3(pos[i[0]],
+            coal_Add_Vec3(coal_Scale_Vec3(uvs[i[0]].x, engine->canvasU),
+                          coal_Scale_Vec3(uvs[i[0]].y, engine->canvasV)));
+        engine->canvas = true;
+        break;
+    }
+    if (!engine->canvas)
+        return;
+
+    const float scale = sqrtf(MAX(coal_Dot_Vec3(engine->canvasU, engine->canvasU),
+                                  coal_Dot_Vec3(engine->canvasV, engine->canvasV)));
+    const float tolerance = 1e-4 * scale;
+    for (uint32_t i = 0; i < indexCount && engine->canvas; i++)
+    {
+        const Vec2 uv = uvs[indices[i]];
+        const Vec3 p  = coal_Add_Vec3(engine->canvasOrigin,
+                            coal_Add_Vec3(coal_Scale_Vec3(uv.x, engine->canvasU),
+                                          coal_Scale_Vec3(uv.y, engine->canvasV)));
+        const Vec3 d  = coal_Sub_Vec3(p, pos[indices[i]]);
+        engine->canvas = coal_Dot_Vec3(d, d) <= tolerance * tolerance;
+    }
+}
+
+// gathers what the hit shader needs of each triangle into one record. 
+// the geo may live in device memory, so it's read back through a staging 
+// region. runs when the prim is added or its topology changes.
+static void
+buildTriangleRecords(Engine* engine, const Obdn_Geometry* geo)
+{
+    const VkDeviceSize uvSize    = obdn_GetAttrRange(geo, "uv");
+    const VkDeviceSize posSize   = obdn_GetAttrRange(geo, "pos");
+    const VkDeviceSize indexSize = sizeof(uint32_t) * geo->indexCount;
+
+    BufferRegion staging = obdn_RequestBufferRegion(
+        engine->memory, uvSize + posSize + indexSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT, OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+
+    const VkBufferCopy vertexCopies[] = {
+        {.srcOffset = obdn_GetAttrOffset(geo, "uv"),
+         .dstOffset = staging.offset,
+         .size      = uvSize},
+        {.srcOffset = obdn_GetAttrOffset(geo, "pos"),
+         .dstOffset = staging.offset + uvSize,
+         .size      = posSize}};
+    const VkBufferCopy indexCopy = {
+        .srcOffset = geo->indexRegion.offset,
+        .dstOffset = staging.offset + uvSize + posSize,
+        .size      = indexSize};
+
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    vkCmdCopyBuffer(cmd.buffer, geo->vertexRegion.buffer, staging.buffer,
+                    LEN(vertexCopies), vertexCopies);
+    vkCmdCopyBuffer(cmd.buffer, geo->indexRegion.buffer, staging.buffer, 1,
+                    &indexCopy);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+
+    const Vec2*     uvs     = (const Vec2*)staging.hostData;
+    const Vec3*     pos     = (const Vec3*)(staging.hostData + uvSize);
+    const uint32_t* indices = (const uint32_t*)(staging.hostData + uvSize + posSize);
+
+    const uint32_t triangleCount = geo->indexCount / 3;
+
+    if (engine->triangles.size)
+        obdn_FreeBufferRegion(&engine->triangles);
+    engine->triangles = obdn_RequestBufferRegion(
+        engine->memory, sizeof(TriangleRecord) * MAX(triangleCount, 1),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+
+    TriangleRecord* records = (TriangleRecord*)engine->triangles.hostData;
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        const uint32_t* i = indices + 3 * t;
+        const Vec3 p0 = pos[i[0]], p1 = pos[i[1]], p2 = pos[i[2]];
+        const Vec2 a  = {uvs[i[1]].x - uvs[i[0]].x, uvs[i[1]].y - uvs[i[0]].y};
+        const Vec2 b  = {uvs[i[2]].x - uvs[i[0]].x, uvs[i[2]].y - uvs[i[0]].y};
+        const float e1[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+        const float e2[3] = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+        const float n[3]  = {e1[1] * e2[2] - e1[2] * e2[1],
+                             e1[2] * e2[0] - e1[0] * e2[2],
+                             e1[0] * e2[1] - e1[1] * e2[0]};
+        const float area2 = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        records[t] = (TriangleRecord){
+            .uv      = {uvs[i[0]], uvs[i[1]], uvs[i[2]]},
+            .normal  = packNormal(n),
+            .uvScale = sqrtf(fabsf(a.x * b.y - a.y * b.x) / MAX(area2, 1e-12))};
+    }
+
+    detectCanvas(engine, uvs, pos, indices, geo->indexCount);
+
+    obdn_FreeBufferRegion(&staging);
+}
+
+static void
+destroyAccelerationStructures(Engine* engine)
+{
+    if (engine->topLevelAS.handle == VK_NULL_HANDLE)
+        return; // never built, or deferred
+    obdn_DestroyAccelerationStruct(engine->device, &engine->bottomLevelAS);
+    obdn_DestroyAccelerationStruct(engine->device, &engine->topLevelAS);
+    engine->bottomLevelAS = (Obdn_R_AccelerationStructure){0};
+    engine->topLevelAS    = (Obdn_R_AccelerationStructure){0};
+}
+
+static void
+buildAccelerationStructures(Engine* engine)
+{
+    Coal_Mat4 xform = COAL_MAT4_IDENT;
+    obdn_BuildBlas(engine->memory, engine->activeGeo, &engine->bottomLevelAS);
+    obdn_BuildTlas(engine->memory, 1, &engine->bottomLevelAS, &xform,
+                   &engine->topLevelAS);
+    engine->accelStale = false;
+}
+
+static void
+updatePrim(Engine* engine, const Obdn_Scene* scene)
+{
+    assert(engine->activePrim.id != 0);
+    Obdn_Primitive* prim = obdn_GetPrimitive(scene, engine->activePrim.id);
+    if (prim->dirt & OBDN_PRIM_REMOVED_BIT)
+    {
+        destroyAccelerationStructures(engine);
+        if (engine->triangles.size)
+            obdn_FreeBufferRegion(&engine->triangles);
+        engine->triangles  = (BufferRegion){0};
+        engine->activeGeo  = NULL;
+        engine->canvas     = false;
+        engine->activePrim = NULL_PRIM;
+        return;
+    }
+    assert(prim->geo);
+    if (prim->dirt & (OBDN_PRIM_ADDED_BIT | OBDN_PRIM_TOPOLOGY_CHANGED_BIT) ||
+        engine->dirt & PRIM_DIRTY_BITS)
+    {
+        destroyAccelerationStructures(engine);
+        buildTriangleRecords(engine, prim->geo);
+        engine->activeGeo  = prim->geo;
+        engine->accelStale = true;
+        // a canvas may never need them
+        if (!engine->canvas)
+            buildAccelerationStructures(engine);
+
+        updateDescSetPrim(engine);
+        return;
+    }
+}
+
+// picks the tip for the next dab. tips that were never added fall back to 
+// the default so a brush set up before its tips were loaded still paints.
+static Dali_BrushTipId
+pickBrushTip(const Engine* engine, float r)
+{
+    Dali_BrushTipId tip = engine->brushTip;
+    if (engine->brushTipSetSize > 1)
+    {
+        const uint32_t i = (uint32_t)(r * engine->brushTipSetSize);
+        tip += MIN(i, engine->brushTipSetSize - 1);
+    }
+    return tip < engine->brushTipCount ? tip : 0;
+}
+
+// everything random about a dab is drawn from (stroke, dab index) so 
+// replaying a stroke reproduces it exactly
+static Dab
+nextDab(Engine* engine, Vec2 pos, float angleVariation)
+{
+    const uint32_t index = engine->dabCount++;
+    const RngState r = rng_Pcg4d(engine->strokeId, index, RNG_HOST_LAUNCH, 0);
+    const float    var = M_PI * angleVariation;
+
+    const Dab dab = {
+        .pos     = pos,
+        .prevPos = index == 0 ? pos : engine->prevDabPos,
+        .angle   = engine->brushAngle - var + 2.0 * var * rng_Float(r.x),
+        .tip     = pickBrushTip(engine, rng_Float(r.y)),
+        .stroke  = engine->strokeId,
+        .index   = index,
+        .pattern = engine->samplePattern};
+    engine->prevDabPos = pos;
+    return dab;
+}
+
+static bool
+brushSamplesLayer(const Engine* engine)
+{
+    switch (engine->paintMode)
+    {
+    case PAINT_MODE_SMUDGE:
+    case PAINT_MODE_BLUR:
+    case PAINT_MODE_SHARPEN:
+    case PAINT_MODE_CLONE: return !formatInfo(engine)->coverage;
+    default: return false;
+    }
+}
+
+// brings the layer snapshot up to date with imageB. only the texels the 
+// raygen has touched since the last update are copied, unless something 
+// replaced imageB wholesale. must be recorded before the frame's dabs.
+static void
+copyLayerToSnapshot(Engine* engine, const VkCommandBuffer cmdBuf,
+                    const BufferRegion* layer)
+{
+    const VkImageSubresourceRange range = {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = 0,
+        .levelCount     = 1,
+        .baseArrayLayer = 0,
+        .layerCount     = 1};
+
+    VkImageMemoryBarrier barrier = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->snapshotImage.handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &barrier);
+
+    const VkBufferImageCopy copy = {
+        .bufferOffset     = layer->offset,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent      = {engine->textureSize, engine->textureSize, 1}};
+
+    vkCmdCopyBufferToImage(cmdBuf, layer->buffer, engine->snapshotImage.handle,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+    barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0,
+                         NULL, 0, NULL, 1, &barrier);
+}
+
+static void
+updateSnapshot(Engine* engine, const VkCommandBuffer cmdBuf)
+{
+    if (engine->snapshotSource.buffer)
+    {
+        // other layers don't change while painting, one copy is enough
+        if (engine->snapshotStale)
+            copyLayerToSnapshot(engine, cmdBuf, &engine->snapshotSource);
+        engine->snapshotStale = false;
+        return;
+    }
+
+    DirtyRegion* region = (DirtyRegion*)engine->dirtyRegion.hostData;
+
+    VkImageCopy copy = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}};
+
+    if (engine->snapshotStale)
+    {
+        copy.extent = (VkExtent3D){engine->textureSize, engine->textureSize, 1};
+    }
+    else if (region->minX <= region->maxX)
+    {
+        copy.srcOffset = (VkOffset3D){region->minX, region->minY, 0};
+        copy.dstOffset = copy.srcOffset;
+        copy.extent    = (VkExtent3D){region->maxX - region->minX + 1,
+                                   region->maxY - region->minY + 1, 1};
+    }
+    else
+    {
+        return; // nothing painted since the last update
+    }
+
+    resetDirtyRegion(engine);
+    engine->snapshotStale = false;
+
+    const VkImageSubresourceRange range = {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = 0,
+        .levelCount     = 1,
+        .baseArrayLayer = 0,
+        .layerCount     = 1};
+
+    VkImageMemoryBarrier barriers[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageB.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->snapshotImage.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT}};
+
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         LEN(barriers), barriers);
+
+    vkCmdCopyImage(cmdBuf, engine->imageB.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   engine->snapshotImage.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+    barriers[0].oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[1].oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         0, 0, NULL, 0, NULL, LEN(barriers), barriers);
+}
+
+static const SamplePattern*
+dabPattern(const Engine* engine, const Dab* dab)
+{
+    return &engine->tipPatterns[dab->tip][dab->pattern];
+}
+
+// traces count pattern points of the dab, starting at the first one not 
+// yet traced. with accumulate they go to dabImage rather than imageA.
+static void
+splat(Engine* engine, const VkCommandBuffer cmdBuf, const Dab* dab,
+      uint32_t count, bool accumulate)
+{
+    const SamplePattern* pattern = dabPattern(engine, dab);
+    assert(dab->sample + count <= pattern->count);
+    if (count == 0)
+        return; // the tip is empty at this density
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                      engine->paintPipeline);
+
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                            engine->pipelineLayout, 0, 2,
+                            engine->description.descriptorSets, 0, NULL);
+
+    PaintPushConstants pc = {
+        .stroke = dab->stroke,
+        .dab    = dab->index,
+        .brushx = dab->pos.x,
+        .brushy = dab->pos.y,
+        .angle  = dab->angle,
+        .tip    = dab->tip,
+        .prevx  = dab->prevPos.x,
+        .prevy  = dab->prevPos.y,
+        .sampleOffset = pattern->offset + dab->sample,
+        .lod    = pattern->lod,
+        // each ray stands for an equal share of the disc, culled or not
+        .spread = 1.0 / sqrtf(engine->samplePatterns[dab->pattern].count),
+        .accumulate = accumulate};
+
+    vkCmdPushConstants(cmdBuf, engine->pipelineLayout, PAINT_PC_STAGES, 0,
+                       sizeof(pc), &pc);
+
+    vkCmdTraceRaysKHR(cmdBuf, &engine->shaderBindingTable.raygenTable,
+                      &engine->shaderBindingTable.missTable,
+                      &engine->shaderBindingTable.hitTable,
+                      &engine->shaderBindingTable.callableTable, count, 1,
+                      engine->symmetryCopies);
+}
+
+static bool
+canStamp(const Engine* engine)
+{
+    // symmetry and the sampling modes still go through the raygen
+    return engine->canvas && engine->symmetryCopies == 1 &&
+           !brushSamplesLayer(engine);
+}
+
+// where the ray fireRay shoots for screen offset st from brush position 
+// bpos meets the canvas plane, in uv. false if it never does.
+static bool
+canvasUV(const Engine* engine, Vec2 bpos, Vec2 st, Vec2* uv)
+{
+    const UboMatrices* m = (const UboMatrices*)engine->matrixRegion.hostData;
+
+    const Vec4 o = coal_Mult_Mat4Vec4(m->viewInv, (Vec4){0, 0, 0, 1});
+    const Vec4 d = coal_Mult_Mat4Vec4(m->viewInv,
+        (Vec4){st.x + m->projInv.e[0][0] * bpos.x,
+               st.y + m->projInv.e[1][1] * bpos.y, -1, 0});
+    const Vec3 U = engine->canvasU;
+    const Vec3 V = engine->canvasV;
+    const Vec3 n = coal_Cross(U, V);
+
+    const float denom = coal_Dot_Vec3((Vec3){d.x, d.y, d.z}, n);
+    if (fabsf(denom) < 1e-12)
+        return false;
+    const Vec3  toPlane = coal_Sub_Vec3(engine->canvasOrigin, (Vec3){o.x, o.y, o.z});
+    const float t = coal_Dot_Vec3(toPlane, n) / denom;
+    if (t <= 0.0)
+        return false;
+
+    const Vec3 r = coal_Sub_Vec3((Vec3){d.x * t, d.y * t, d.z * t}, toPlane);
+    const float uu = coal_Dot_Vec3(U, U), uv_ = coal_Dot_Vec3(U, V);
+    const float vv = coal_Dot_Vec3(V, V);
+    const float ru = coal_Dot_Vec3(r, U), rv = coal_Dot_Vec3(r, V);
+    const float det = uu * vv - uv_ * uv_;
+    uv->x = (ru * vv - rv * uv_) / det;
+    uv->y = (rv * uu - ru * uv_) / det;
+    return true;
+}
+
+// draws a dab on a canvas with a raster pass over the uvs it can reach. 
+// the plane maps the brush square to a convex quad, so its corners bound 
+// it. no rays, no acceleration structures.
+static void
+stamp(Engine* engine, const VkCommandBuffer cmdBuf, const Dab* dab)
+{
+    const float radius = ((const UboBrush*)engine->brushRegion.hostData)->radius;
+    const Vec2  bpos   = {dab->pos.x * 2.0 - 1.0, dab->pos.y * 2.0 - 1.0};
 
-    for (int l = 0; l < engine->curLayerId; l++)
+    Vec2 lo = {1, 1}, hi = {0, 0};
+    for (int c = 0; c < 4; c++)
     {
-        BufferRegion* layerBuffer = &dali_GetLayer(stack, l)->bufferRegion;
+        const Vec2 st = {c & 1 ? radius : -radius, c & 2 ? radius : -radius};
+        Vec2       uv;
+        if (!canvasUV(engine, bpos, st, &uv))
+        {
+            // the brush reaches the horizon
+            lo = (Vec2){0, 0};
+            hi = (Vec2){1, 1};
+            break;
+        }
+        lo = (Vec2){MIN(lo.x, uv.x), MIN(lo.y, uv.y)};
+        hi = (Vec2){MAX(hi.x, uv.x), MAX(hi.y, uv.y)};
+    }
 
-        obdn_CmdCopyBufferToImage(cmd.buffer, 0, layerBuffer, &engine->imageA);
+    const float size = engine->textureSize;
+    const int32_t last = engine->textureSize - 1;
+    const int32_t x0 = MAX((int32_t)floorf(lo.x * size) - 1, 0);
+    const int32_t y0 = MAX((int32_t)floorf(lo.y * size) - 1, 0);
+    const int32_t x1 = MIN((int32_t)ceilf(hi.x * size) + 1, last);
+    const int32_t y1 = MIN((int32_t)ceilf(hi.y * size) + 1, last);
+    if (x0 > x1 || y0 > y1)
+        return; // off the canvas
+
+    // a fragment per texel in the disc the box bounds stands in for a ray
+    const Image*   tip    = &engine->brushTips[dab->tip];
+    const uint32_t texels = (x1 - x0 + 1) * (y1 - y0 + 1) * M_PI / 4.0;
+
+    StampPushConstants pc = {
+        .dab = {.stroke = dab->stroke,
+                .dab    = dab->index,
+                .brushx = dab->pos.x,
+                .brushy = dab->pos.y,
+                .angle  = dab->angle,
+                .tip    = dab->tip,
+                .lod    = tipLod(tip->extent.width, tip->extent.height,
+                                 MAX(texels, 1))},
+        .uvMin  = {x0 / size, y0 / size},
+        .uvMax  = {(x1 + 1) / size, (y1 + 1) / size},
+        .origin = {engine->canvasOrigin.x, engine->canvasOrigin.y, engine->canvasOrigin.z},
+        .u      = {engine->canvasU.x, engine->canvasU.y, engine->canvasU.z},
+        .v      = {engine->canvasV.x, engine->canvasV.y, engine->canvasV.z}};
+
+    // the raygen grows the dirty region itself
+    DirtyRegion* region = (DirtyRegion*)engine->dirtyRegion.hostData;
+    region->minX = MIN(region->minX, (uint32_t)x0);
+    region->minY = MIN(region->minY, (uint32_t)y0);
+    region->maxX = MAX(region->maxX, (uint32_t)x1);
+    region->maxY = MAX(region->maxY, (uint32_t)y1);
 
-        VkClearValue clear = {0.0f, 0.903f, 0.009f, 1.0f};
+    const VkRenderPassBeginInfo rpass = {
+        .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderArea  = {{x0, y0}, {x1 - x0 + 1, y1 - y0 + 1}},
+        .renderPass  = engine->stampRenderPass,
+        .framebuffer = engine->stampFrameBuffer};
 
-        const VkRenderPassBeginInfo rpass = {
-            .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .clearValueCount = 1,
-            .pClearValues    = &clear,
-            .renderArea  = {{0, 0}, {engine->textureSize, engine->textureSize}},
-            .renderPass  = engine->singleCompositeRenderPass,
-            .framebuffer = engine->backgroundFrameBuffer,
-        };
+    vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
 
-        vkCmdBeginRenderPass(cmd.buffer, &rpass, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            engine->pipelineLayout, DESC_SET_PAINT, 1,
+                            &engine->description.descriptorSets[DESC_SET_PAINT],
+                            0, NULL);
 
-        vkCmdBindDescriptorSets(
-            cmd.buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->pipelineLayout,
-            DESC_SET_COMP, 1,
-            &engine->description.descriptorSets[DESC_SET_COMP], 0, NULL);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      engine->stampPipeline);
 
-        vkCmdBindPipeline(cmd.buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          engine->compPipelines[PIPELINE_COMP_SINGLE]);
+    vkCmdPushConstants(cmdBuf, engine->pipelineLayout, PAINT_PC_STAGES, 0,
+                       sizeof(pc), &pc);
 
-        vkCmdDraw(cmd.buffer, 3, 1, 0, 0);
+    vkCmdDraw(cmdBuf, 6, 1, 0, 0);
 
-        vkCmdEndRenderPass(cmd.buffer);
-    }
+    vkCmdEndRenderPass(cmdBuf);
+}
 
-    const int layerCount = dali_GetLayerCount(stack);
+static void
+applyPaint(Engine* engine, const VkCommandBuffer cmdBuf)
+{
+    VkClearValue clear = {0, 0, 0, 0};
 
-    for (int l = engine->curLayerId + 1; l < layerCount; l++)
-    {
-        BufferRegion* layerBuffer = &dali_GetLayer(stack, l)->bufferRegion;
+    const VkRenderPassBeginInfo rpass = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .clearValueCount = 1,
+        .pClearValues    = &clear,
+        .renderArea      = {{0, 0}, {engine->textureSize, engine->textureSize}},
+        .renderPass      = engine->applyPaintRenderPass,
+        .framebuffer     = engine->applyPaintFrameBuffer};
 
-        obdn_CmdCopyBufferToImage(cmd.buffer, 0, layerBuffer, &engine->imageA);
+    vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
 
-        VkClearValue clear = {0.0f, 0.903f, 0.009f, 1.0f};
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            engine->pipelineLayout, DESC_SET_COMP, 1,
+                            &engine->description.descriptorSets[DESC_SET_COMP],
+                            0, NULL);
 
-        const VkRenderPassBeginInfo rpass = {
-            .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .clearValueCount = 1,
-            .pClearValues    = &clear,
-            .renderArea  = {{0, 0}, {engine->textureSize, engine->textureSize}},
-            .renderPass  = engine->singleCompositeRenderPass,
-            .framebuffer = engine->foregroundFrameBuffer,
-        };
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      engine->compPipelines[PIPELINE_COMP_1]);
 
-        vkCmdBeginRenderPass(cmd.buffer, &rpass, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
 
-        // may not need this because same parameters as last bind?
-        vkCmdBindDescriptorSets(
-            cmd.buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->pipelineLayout,
-            DESC_SET_COMP, 1,
-            &engine->description.descriptorSets[DESC_SET_COMP], 0, NULL);
+    vkCmdEndRenderPass(cmdBuf);
+}
 
-        vkCmdBindPipeline(cmd.buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          engine->compPipelines[PIPELINE_COMP_SINGLE]);
+// composites everything from liveStart up over C in order, the way 
+// compositeLayers does. B is copied out so the batches can read it like a 
+// layer, and the isolated group's cache is redone around it with D as 
+// scratch. then D is the target, starting from a copy of C. the result 
+// ends up in A, laid out as the composite pass leaves it.
+static void
+compLive(Engine* engine, Dali_LayerStack* stack, const VkCommandBuffer cmdBuf)
+{
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
 
-        vkCmdDraw(cmd.buffer, 3, 1, 0, 0);
+    const Dali_LayerGroupId isolated = engine->isolatedGroup;
+    engine->activeSource = &engine->activeCopy;
 
-        vkCmdEndRenderPass(cmd.buffer);
-    }
+    const VkImageCopy copy = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .extent         = {engine->textureSize, engine->textureSize, 1}};
 
-    VkImageMemoryBarrier barrier1 = {
-        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .image            = engine->imageB.handle,
-        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .subresourceRange = subResRange,
-        .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
-        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+    const VkImageMemoryBarrier toTransfer[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageB.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageC.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = 0,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageD.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = 0,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT}};
 
-    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
-                         &barrier1);
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         LEN(toTransfer), toTransfer);
 
-    BufferRegion* layerBuffer =
-        &dali_GetLayer(stack, engine->curLayerId)->bufferRegion;
+    obdn_CmdCopyImageToBuffer(cmdBuf, 0, &engine->imageB, &engine->activeCopy);
 
-    obdn_CmdCopyBufferToImage(cmd.buffer, 0, layerBuffer, &engine->imageB);
+    if (isolated != DALI_LAYER_GROUP_NONE)
+    {
+        transferBarrier(cmdBuf);
+
+        const VkImageMemoryBarrier toScratch = {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .image            = engine->imageD.handle,
+            .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .subresourceRange = range,
+            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+
+        const VkClearColorValue clearColor = {0};
+        vkCmdClearColorImage(cmdBuf, engine->imageD.handle,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor,
+                             1, &range);
+
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             0, 0, NULL, 0, NULL, 1, &toScratch);
+
+        // B changes every frame, and with it every group on its path
+        layer_MarkAncestorsStale(stack,
+                                 stack->layers[engine->curLayerId].group);
+        refreshGroup(engine, stack, cmdBuf, isolated, &engine->imageD,
+                     engine->foregroundFrameBuffer,
+                     engine->compPipelines[PIPELINE_COMP_FOREGROUND]);
+
+        const VkImageMemoryBarrier toDst = {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .image            = engine->imageD.handle,
+            .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .subresourceRange = range,
+            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+        vkCmdPipelineBarrier(cmdBuf,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                             NULL, 1, &toDst);
+    }
 
-    VkImageMemoryBarrier barriers2[] = {
-        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-         .image            = engine->imageA.handle,
-         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
-         .dstAccessMask    = 0},
+    vkCmdCopyImage(cmdBuf, engine->imageC.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, engine->imageD.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+    transferBarrier(cmdBuf);
+
+    const VkImageMemoryBarrier toComp[] = {
         {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
          .image            = engine->imageB.handle,
-         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
          .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = VK_ACCESS_MEMORY_READ_BIT,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
          .dstAccessMask    = 0},
         {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
          .image            = engine->imageC.handle,
-         .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
          .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
          .dstAccessMask    = 0},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageD.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT |
+                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT}};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, NULL, 0, NULL, LEN(toComp), toComp);
+
+    compositeLayers(engine, stack, cmdBuf, engine->liveStart,
+                    dali_GetLayerCount(stack), engine->foregroundFrameBuffer,
+                    engine->compPipelines[PIPELINE_COMP_FOREGROUND]);
+    engine->activeSource = NULL;
+
+    // A's dabs are already in B
+    const VkImageMemoryBarrier toCopy[] = {
         {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
          .image            = engine->imageD.handle,
          .oldLayout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageA.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+         .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT}};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         LEN(toCopy), toCopy);
+
+    vkCmdCopyImage(cmdBuf, engine->imageD.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, engine->imageA.handle,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+    const VkImageMemoryBarrier toRead[] = {
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageD.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
          .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-         .subresourceRange = subResRange,
-         .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
-         .dstAccessMask    = 0}};
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+         .dstAccessMask    = 0},
+        {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .image            = engine->imageA.handle,
+         .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         .subresourceRange = range,
+         .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT}};
 
-    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
-                         NULL, LEN(barriers), barriers2);
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         0, 0, NULL, 0, NULL, LEN(toRead), toRead);
+}
 
-    obdn_EndCommandBuffer(cmd.buffer);
+static void
+comp(Engine* engine, Dali_LayerStack* stack, const VkCommandBuffer cmdBuf)
+{
+    if (engine->liveComp)
+    {
+        compLive(engine, stack, cmdBuf);
+        return;
+    }
 
-    obdn_SubmitAndWait(&cmd, 0);
+    VkClearValue clear = {0, 0, 0, 0};
 
-    obdn_DestroyCommand(cmd);
+    VkClearValue clears[] = {clear, clear, clear, clear};
 
-    hell_DebugPrint(PAINT_DEBUG_TAG_PAINT, "End\n");
+    const VkRenderPassBeginInfo rpass = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .clearValueCount = LEN(clears),
+        .pClearValues    = clears,
+        .renderArea      = {{0, 0}, {engine->textureSize, engine->textureSize}},
+        .renderPass      = engine->compositeRenderPass,
+        .framebuffer     = engine->compositeFrameBuffer};
+
+    vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      engine->compPipelines[PIPELINE_COMP_3]);
+
+    vkCmdPushConstants(cmdBuf, engine->pipelineLayout, PAINT_PC_STAGES, 0,
+                       sizeof(engine->activeLayerComp),
+                       &engine->activeLayerComp);
+
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+
+    vkCmdNextSubpass(cmdBuf, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      engine->compPipelines[PIPELINE_COMP_4]);
+
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+
+    vkCmdEndRenderPass(cmdBuf);
 }
 
-static void
-runUndoCommands(Engine* engine, const bool toHost /*vs fromHost*/, BufferRegion* bufferRegion)
+static uint32_t
+samplesLeft(const Engine* engine, const Dab* dab)
 {
-    obdn_WaitForFence(engine->device, &engine->cmdAcquireImageTranferSource.fence);
+    return dabPattern(engine, dab)->count - dab->sample;
+}
 
-    obdn_ResetCommand(&engine->cmdReleaseImageTransferSource);
-    obdn_ResetCommand(&engine->cmdTranferImage);
-    obdn_ResetCommand(&engine->cmdAcquireImageTranferSource);
+static uint32_t
+dabRays(const Engine* engine, const Dab* dab)
+{
+    return samplesLeft(engine, dab) * engine->symmetryCopies;
+}
 
-    VkCommandBuffer cmdBuf = engine->cmdReleaseImageTransferSource.buffer;
+// builds the acceleration structures a canvas put off once a dab or a 
+// pick needs them. runs before any recording: the prim set may not change under a 
+// command buffer that has it bound.
+static void
+buildDeferredAccel(Engine* engine)
+{
+    if (!engine->accelStale || !engine->activeGeo)
+        return;
+    if (canStamp(engine) && engine->pickQueueCount == 0)
+        return;
+    buildAccelerationStructures(engine);
+    updateDescSetPrim(engine);
+}
 
-    obdn_BeginCommandBuffer(cmdBuf);
+// orders a transfer into dabImage or imageA before the passes that draw 
+// into or read them
+static void
+dabTransferBarrier(const VkCommandBuffer cmdBuf)
+{
+    const VkMemoryBarrier barrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
 
-    const VkImageSubresourceRange range = {.aspectMask =
-                                               VK_IMAGE_ASPECT_COLOR_BIT,
-                                           .baseMipLevel   = 0,
-                                           .levelCount     = 1,
-                                           .baseArrayLayer = 0,
-                                           .layerCount     = 1};
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 1, &barrier, 0, NULL, 0, NULL);
+}
 
-    const VkImageLayout otherLayout =
-        toHost ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-               : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    const VkAccessFlags otherAccessMask =
-        toHost ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+// copies what a dab's earlier slices covered from dabImage into imageA, 
+// so its last slice finishes it there. their frames have signaled, so the 
+// dirty region has them. both images are in GENERAL.
+static void
+restoreDab(Engine* engine, const VkCommandBuffer cmdBuf)
+{
+    DirtyRegion region = engine->dabRegion;
+    growRegion(&region, (const DirtyRegion*)engine->dirtyRegion.hostData);
+    region.maxX = MIN(region.maxX, engine->textureSize - 1);
+    region.maxY = MIN(region.maxY, engine->textureSize - 1);
+    if (region.minX > region.maxX || region.minY > region.maxY)
+        return; // the slices all missed
+
+    const VkMemoryBarrier before = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    // imageA was just cleared
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, NULL,
+                         0, NULL);
+
+    const VkImageCopy copy = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .srcOffset      = {region.minX, region.minY, 0},
+        .dstOffset      = {region.minX, region.minY, 0},
+        .extent         = {region.maxX - region.minX + 1,
+                           region.maxY - region.minY + 1, 1}};
+
+    vkCmdCopyImage(cmdBuf, engine->dabImage.handle, VK_IMAGE_LAYOUT_GENERAL,
+                   engine->imageA.handle, VK_IMAGE_LAYOUT_GENERAL, 1, &copy);
+}
 
-    VkImageMemoryBarrier imgBarrier = {
-        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .pNext               = NULL,
-        .srcAccessMask       = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
-        .dstAccessMask       = 0, /* ignored for this batter */
-        .oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        .newLayout           = otherLayout,
-        .srcQueueFamilyIndex = engine->graphicsQueueFamilyIndex,
-        .dstQueueFamilyIndex = engine->transferQueueFamilyIndex,
-        .image               = engine->imageB.handle,
-        .subresourceRange    = range};
+// traces count more points of a dab and blends the dab into the layer 
+// once all its points are in. a dab drawn whole goes into a cleared 
+// imageA. one drawn in slices gathers them in dabImage, where previewDab 
+// shows them, and its last slice goes into imageA on top of what the 
+// others covered. imageA must be in GENERAL.
+static void
+drawDab(Engine* engine, const VkCommandBuffer cmdBuf, const Dab* dab,
+        uint32_t count)
+{
+    if (count == 0)
+        return;
 
-    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
-                         &imgBarrier);
+    const bool first = dab->sample == 0;
+    const bool last  = dab->sample + count >= dabPattern(engine, dab)->count;
 
-    obdn_EndCommandBuffer(cmdBuf);
+    const VkClearColorValue clearColor = {.float32 = {0, 0, 0, 0}};
 
-    cmdBuf = engine->cmdTranferImage.buffer;
+    const VkImageSubresourceRange range = {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = 0,
+        .levelCount     = 1,
+        .baseArrayLayer = 0,
+        .layerCount     = 1};
 
-    obdn_BeginCommandBuffer(cmdBuf);
+    if (!last)
+    {
+        // drainDabs only slices what the raygen traces
+        assert(!canStamp(engine));
+        if (first)
+        {
+            vkCmdClearColorImage(cmdBuf, engine->dabImage.handle,
+                                 VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1,
+                                 &range);
+            dabTransferBarrier(cmdBuf);
+            engine->dabRegion = (DirtyRegion){UINT32_MAX, UINT32_MAX, 0, 0};
+        }
+        splat(engine, cmdBuf, dab, count, true);
+        return;
+    }
 
-// if is where the first validation message occurs
-    imgBarrier.srcAccessMask = 0;
-    imgBarrier.dstAccessMask = otherAccessMask;
+    vkCmdClearColorImage(cmdBuf, engine->imageA.handle,
+                         VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &range);
 
-    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
-                         &imgBarrier);
+    if (!first)
+        restoreDab(engine, cmdBuf);
 
-    if (toHost)
-        obdn_CmdCopyImageToBuffer(cmdBuf, 0, &engine->imageB, bufferRegion);
+    dabTransferBarrier(cmdBuf);
+
+    if (canStamp(engine))
+        stamp(engine, cmdBuf, dab);
     else
-        obdn_CmdCopyBufferToImage(cmdBuf, 0, bufferRegion, &engine->imageB);
+        splat(engine, cmdBuf, dab, count, false);
 
-    imgBarrier.srcAccessMask       = otherAccessMask;
-    imgBarrier.dstAccessMask       = 0; //again, not used on this half of the ownership tranfer but validation layers complain
-    imgBarrier.oldLayout           = otherLayout;
-    imgBarrier.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imgBarrier.srcQueueFamilyIndex = engine->transferQueueFamilyIndex;
-    imgBarrier.dstQueueFamilyIndex = engine->graphicsQueueFamilyIndex;
+    applyPaint(engine, cmdBuf);
+}
 
-    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
-                         &imgBarrier);
+// lays the slices of a dab still being traced over the composite in 
+// imageA. the layer only gets the dab once it's done. imageA goes from and 
+// back to SHADER_READ_ONLY_OPTIMAL, as comp leaves it.
+static void
+previewDab(Engine* engine, const VkCommandBuffer cmdBuf)
+{
+    if (engine->dabQueueCount == 0 ||
+        engine->dabQueue[engine->dabQueueHead].sample == 0)
+        return;
 
-    obdn_EndCommandBuffer(cmdBuf);
+    const VkMemoryBarrier slices = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+
+    VkImageMemoryBarrier barrier = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageA.handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 1, &slices, 0, NULL, 1, &barrier);
 
-    cmdBuf = engine->cmdAcquireImageTranferSource.buffer;
+    const VkRenderPassBeginInfo rpass = {
+        .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderArea  = {{0, 0}, {engine->textureSize, engine->textureSize}},
+        .renderPass  = engine->stampRenderPass,
+        .framebuffer = engine->stampFrameBuffer};
 
-    obdn_BeginCommandBuffer(cmdBuf);
+    vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
 
-    imgBarrier.srcAccessMask = 0; // will be ignored 
-    imgBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            engine->pipelineLayout, DESC_SET_PAINT, 1,
+                            &engine->description.descriptorSets[DESC_SET_PAINT],
+                            0, NULL);
 
-    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT, 0, NULL, 0, NULL, 1,
-                         &imgBarrier);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      engine->compPipelines[PIPELINE_COMP_DAB_PREVIEW]);
 
-    obdn_EndCommandBuffer(cmdBuf);
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
 
-    obdn_SubmitGraphicsCommand(
-        engine->instance, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, NULL, 1,
-        &engine->cmdReleaseImageTransferSource.semaphore, VK_NULL_HANDLE,
-        engine->cmdReleaseImageTransferSource.buffer);
+    vkCmdEndRenderPass(cmdBuf);
 
-    obdn_SubmitTransferCommand(engine->instance, 0,
-                               VK_PIPELINE_STAGE_TRANSFER_BIT,
-                               &engine->cmdReleaseImageTransferSource.semaphore,
-                               VK_NULL_HANDLE, &engine->cmdTranferImage);
+    barrier.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-    obdn_SubmitGraphicsCommand(
-        engine->instance, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 1,
-        &engine->cmdTranferImage.semaphore, 1,
-        &engine->cmdAcquireImageTranferSource.semaphore,
-        engine->cmdAcquireImageTranferSource.fence, engine->cmdAcquireImageTranferSource.buffer);
+    // tracePicks waits on the color output stage
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, NULL, 0, NULL, 1, &barrier);
 }
 
-static void
-backupLayer(Engine* engine, Dali_UndoManager* undo)
+static Dab
+popDab(Engine* engine)
 {
-    runUndoCommands(engine, true, dali_GetNextUndoBuffer(undo));
-    hell_DebugPrint(DTAG, "layer backed up\n");
+    assert(engine->dabQueueCount > 0);
+    const Dab dab = engine->dabQueue[engine->dabQueueHead];
+    engine->dabQueueHead = (engine->dabQueueHead + 1) % DAB_QUEUE_SIZE;
+    engine->dabQueueCount--;
+    return dab;
 }
 
-static bool
-undo(Engine* engine, Dali_UndoManager* undo)
+// a full queue hands its oldest dab to this frame rather than drop one
+static void
+queueDab(Engine* engine, const VkCommandBuffer cmdBuf, const Dab* dab,
+         uint32_t* rays)
 {
-    hell_DebugPrint(DTAG, "undo\n");
-    BufferRegion* buf = dali_GetLastUndoBuffer(undo);
-    if (!buf)
-        return false; // nothing to undo
-    runUndoCommands(engine, false, buf);
-    return true;
+    if (engine->dabQueueCount == DAB_QUEUE_SIZE)
+    {
+        const Dab oldest = popDab(engine);
+        *rays += dabRays(engine, &oldest);
+        drawDab(engine, cmdBuf, &oldest, samplesLeft(engine, &oldest));
+    }
+    const uint32_t tail =
+        (engine->dabQueueHead + engine->dabQueueCount++) % DAB_QUEUE_SIZE;
+    engine->dabQueue[tail] = *dab;
 }
 
+// draws queued dabs in order until the next one would go over the frame's 
+// ray budget. the first always goes so a stroke never stalls. with resting 
+// set, the newest dab is the one under a brush that hasn't moved: it gets 
+// one slice of progressiveRays and stays queued until it's fully traced or 
+// the stroke moves on. the slices gather in dabImage and the dab is 
+// blended once, so it comes out the same as the dab drawn whole; until 
+// then previewDab shows them.
 static void
-updateView(Engine* engine, const Obdn_Scene* scene)
+drainDabs(Engine* engine, const VkCommandBuffer cmdBuf, uint32_t* rays,
+          bool resting)
 {
-    UboMatrices* matrices = (UboMatrices*)engine->matrixRegion.hostData;
-    matrices->view        = obdn_GetCameraView(scene);
-    matrices->viewInv     = coal_Invert4x4(matrices->view); //TODO: replace with cam.xform
+    double budget = INFINITY;
+    if (engine->frameBudget > 0.0 && engine->nsPerRay > 0.0)
+        budget = engine->frameBudget * 1e6 / engine->nsPerRay;
+
+    while (engine->dabQueueCount > 0)
+    {
+        Dab* next = &engine->dabQueue[engine->dabQueueHead];
+        // stamps are cheap enough to draw whole
+        if (resting && engine->progressiveRays > 0 &&
+            engine->dabQueueCount == 1 && !canStamp(engine))
+        {
+            const uint32_t perFrame =
+                MAX(engine->progressiveRays / engine->symmetryCopies, 1);
+            const uint32_t count = MIN(perFrame, samplesLeft(engine, next));
+            const uint32_t cost  = count * engine->symmetryCopies;
+            if (*rays > 0 && *rays + cost > budget)
+                break;
+            *rays += cost;
+            drawDab(engine, cmdBuf, next, count);
+            next->sample += count;
+            if (samplesLeft(engine, next) == 0)
+                popDab(engine);
+            break;
+        }
+        const uint32_t cost = dabRays(engine, next);
+        if (*rays > 0 && *rays + cost > budget)
+            break;
+        const Dab dab = popDab(engine);
+        *rays += cost;
+        drawDab(engine, cmdBuf, &dab, samplesLeft(engine, &dab));
+    }
 }
 
+// queued dabs were made for the current camera and brush settings. a 
+// change to those keeps what they were made for and leaves the dabs to 
+// the next frame's command buffer. the oldest kept settings win: nothing 
+// is queued under newer ones till that frame is recorded.
 static void
-updateProj(Engine* engine, const Obdn_Scene* scene)
+deferFlush(Engine* engine)
 {
-    UboMatrices* matrices = (UboMatrices*)engine->matrixRegion.hostData;
-    matrices->proj        = obdn_GetCameraProjection(scene);
-    matrices->projInv     = coal_Invert4x4(matrices->proj);
+    if (engine->dabQueueCount == 0 || engine->flushDeferred)
+        return;
+    engine->flushDeferred       = true;
+    engine->flushMatrices       = *(const UboMatrices*)engine->matrixRegion.hostData;
+    engine->flushBrush          = *(const UboBrush*)engine->brushRegion.hostData;
+    engine->flushSymmetryCopies = engine->symmetryCopies;
 }
 
+// trades the kept settings with the current ones on the host, for what 
+// the dabs read while they're recorded, and in the ubos, for what they 
+// read on the gpu
 static void
-updateBrushColor(Engine* engine, float r, float g, float b)
+swapFlushSettings(Engine* engine, const VkCommandBuffer cmdBuf)
 {
-    UboBrush* brush = (UboBrush*)engine->brushRegion.hostData;
-    brush->r        = r;
-    brush->g        = g;
-    brush->b        = b;
+    UboMatrices*      matrices = (UboMatrices*)engine->matrixRegion.hostData;
+    UboBrush*         brush    = (UboBrush*)engine->brushRegion.hostData;
+    const UboMatrices m        = *matrices;
+    const UboBrush    b        = *brush;
+    const uint32_t    copies   = engine->symmetryCopies;
+
+    *matrices                   = engine->flushMatrices;
+    *brush                      = engine->flushBrush;
+    engine->symmetryCopies      = engine->flushSymmetryCopies;
+    engine->flushMatrices       = m;
+    engine->flushBrush          = b;
+    engine->flushSymmetryCopies = copies;
+
+    const VkMemoryBarrier before = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_UNIFORM_READ_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0,
+                         NULL, 0, NULL);
+
+    vkCmdUpdateBuffer(cmdBuf, engine->matrixRegion.buffer,
+                      engine->matrixRegion.offset, sizeof(UboMatrices),
+                      matrices);
+    vkCmdUpdateBuffer(cmdBuf, engine->brushRegion.buffer,
+                      engine->brushRegion.offset, sizeof(UboBrush), brush);
+
+    const VkMemoryBarrier after = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_HOST_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &after, 0, NULL, 0, NULL);
 }
 
+// draws the whole queue under the settings it was made for. imageA must 
+// be in GENERAL.
 static void
-syncBrush(Engine* engine, const Dali_Brush* b)
+drawQueuedDabs(Engine* engine, const VkCommandBuffer cmdBuf, uint32_t* rays)
 {
-    UboBrush* brush = (UboBrush*)engine->brushRegion.hostData;
-
-    if (b->dirt & BRUSH_PAINT_MODE_BIT)
-    {
-        vkDeviceWaitIdle(engine->device);
-        destroyCompPipelines(engine);
-        initCompPipelines(engine, b->mode);
-    }
+    const bool deferred = engine->flushDeferred;
+    engine->flushDeferred = false;
+    if (deferred)
+        swapFlushSettings(engine, cmdBuf);
 
-    if (b->dirt & BRUSH_GENERAL_BIT)
+    while (engine->dabQueueCount > 0)
     {
-        if (b->mode != PAINT_MODE_ERASE)
-            updateBrushColor(engine, b->r, b->g, b->b);
-        else
-            updateBrushColor(engine, 1, 1, 1); // must be white for erase to work
-        engine->brushActive = b->active;
-
-        engine->prevBrushPos.x = engine->brushPos.x;
-        engine->prevBrushPos.y = engine->brushPos.y;
-        engine->brushPos.x     = b->x;
-        engine->brushPos.y     = b->y;
-        engine->brushSpacing   = b->spacing;
-        engine->brushAngle     = b->angle;
-        engine->brushAngleVariation = b->angleVariation;
-
-        brush->radius       = b->radius;
-        brush->x            = b->x;
-        brush->y            = b->y;
-        brush->opacity      = b->opacity;
-        brush->anti_falloff = (1.0 - b->falloff) * b->radius;
+        const Dab dab = popDab(engine);
+        *rays += dabRays(engine, &dab);
+        drawDab(engine, cmdBuf, &dab, samplesLeft(engine, &dab));
     }
 
-    if (b->dirt & BRUSH_ALPHA_BIT)
-    {
-        if (b->alphaImg)
-        {
-            updateDescriptorsAlphaImage(engine, b->alphaImg);
-        }
-        else 
-        {
-            updateDescriptorsAlphaImage(engine, &engine->defaultBrushAlpha);
-        }
-    }
+    if (deferred)
+        swapFlushSettings(engine, cmdBuf);
 }
 
+// the layer, paint mode, prims and undo can't be put back for a later 
+// command buffer like the ubos, so changes to those draw the queued dabs 
+// first, outside the frame
 static void
-updatePrim(Engine* engine, const Obdn_Scene* scene)
+flushDabs(Engine* engine)
 {
-    assert(engine->activePrim.id != 0);
-    Obdn_Primitive* prim = obdn_GetPrimitive(scene, engine->activePrim.id);
-    if (prim->dirt & OBDN_PRIM_REMOVED_BIT)
-    {
-        obdn_DestroyAccelerationStruct(engine->device, &engine->bottomLevelAS);
-        obdn_DestroyAccelerationStruct(engine->device, &engine->topLevelAS);
-        engine->activePrim = NULL_PRIM;
-        return;
-    }
-    assert(prim->geo);
-    if (prim->dirt & OBDN_PRIM_ADDED_BIT || engine->dirt & DALI_PRIM_ADDED_BIT)
-    {
-        Coal_Mat4 xform = COAL_MAT4_IDENT;
-        obdn_BuildBlas(engine->memory, prim->geo, &engine->bottomLevelAS);
-        obdn_BuildTlas(engine->memory, 1, &engine->bottomLevelAS, &xform,
-                       &engine->topLevelAS);
-
-        updateDescSetPrim(engine, scene);
+    if (engine->dabQueueCount == 0)
         return;
-    }
-    if (prim->dirt & OBDN_PRIM_TOPOLOGY_CHANGED_BIT || engine->dirt & DALI_PRIM_CHANGED_BIT)
-    {
-        obdn_DestroyAccelerationStruct(engine->device, &engine->bottomLevelAS);
-        obdn_DestroyAccelerationStruct(engine->device, &engine->topLevelAS);
-        Coal_Mat4 xform = COAL_MAT4_IDENT;
-        obdn_BuildBlas(engine->memory, prim->geo, &engine->bottomLevelAS);
-        obdn_BuildTlas(engine->memory, 1, &engine->bottomLevelAS, &xform,
-                       &engine->topLevelAS);
 
-        updateDescSetPrim(engine, scene);
-        return;
-    }
-}
+    buildDeferredAccel(engine);
 
-static void
-splat(Engine* engine, const VkCommandBuffer cmdBuf, const float x,
-      const float y, float angle, uint32_t rayWidth)
-{
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-                      engine->paintPipeline);
+    Obdn_Command cmd =
+        obdn_CreateCommand(engine->instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
 
-    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-                            engine->pipelineLayout, 0, 2,
-                            engine->description.descriptorSets, 0, NULL);
+    obdn_BeginCommandBuffer(cmd.buffer);
 
-    float pc[5] = {coal_Rand(), coal_Rand(), x, y, angle};
+    if (brushSamplesLayer(engine))
+        updateSnapshot(engine, cmd.buffer);
 
-    vkCmdPushConstants(cmdBuf, engine->pipelineLayout,
-                       VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0, sizeof(pc), pc);
+    VkImageMemoryBarrier barrier = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageA.handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        .srcAccessMask    = 0,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT};
 
-    vkCmdTraceRaysKHR(cmdBuf, &engine->shaderBindingTable.raygenTable,
-                      &engine->shaderBindingTable.missTable,
-                      &engine->shaderBindingTable.hitTable,
-                      &engine->shaderBindingTable.callableTable, rayWidth, rayWidth, 1);
-}
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                         &barrier);
 
-static void
-applyPaint(Engine* engine, const VkCommandBuffer cmdBuf)
-{
-    VkClearValue clear = {0, 0, 0, 0};
+    uint32_t rays = 0;
+    drawQueuedDabs(engine, cmd.buffer, &rays);
 
-    const VkRenderPassBeginInfo rpass = {
-        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .clearValueCount = 1,
-        .pClearValues    = &clear,
-        .renderArea      = {{0, 0}, {engine->textureSize, engine->textureSize}},
-        .renderPass      = engine->applyPaintRenderPass,
-        .framebuffer     = engine->applyPaintFrameBuffer};
+    // the frame's composite overwrites imageA anyway
+    barrier.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    barrier.dstAccessMask = 0;
 
-    vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdPipelineBarrier(cmd.buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
 
-    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            engine->pipelineLayout, DESC_SET_COMP, 1,
-                            &engine->description.descriptorSets[DESC_SET_COMP],
-                            0, NULL);
+    hostReadBarrier(cmd.buffer);
 
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      engine->compPipelines[PIPELINE_COMP_1]);
+    obdn_EndCommandBuffer(cmd.buffer);
 
-    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+    obdn_SubmitAndWait(&cmd, 0);
 
-    vkCmdEndRenderPass(cmdBuf);
+    obdn_DestroyCommand(cmd);
 }
 
+// folds an earlier frame's dab timings into the per ray estimate. results 
+// that aren't ready by the time the slot comes around again are skipped.
 static void
-comp(Engine* engine, const VkCommandBuffer cmdBuf)
+readTimestamps(Engine* engine, uint32_t slot)
 {
-    VkClearValue clear = {0, 0, 0, 0};
+    const uint32_t rays = engine->timestampRays[slot];
+    engine->timestampRays[slot] = 0;
+    if (rays == 0)
+        return;
 
-    VkClearValue clears[] = {clear, clear, clear, clear};
+    uint64_t ticks[2];
+    if (vkGetQueryPoolResults(engine->device, engine->timestampPool, 2 * slot,
+                              2, sizeof(ticks), ticks, sizeof(ticks[0]),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
 
-    const VkRenderPassBeginInfo rpass = {
-        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .clearValueCount = LEN(clears),
-        .pClearValues    = clears,
-        .renderArea      = {{0, 0}, {engine->textureSize, engine->textureSize}},
-        .renderPass      = engine->compositeRenderPass,
-        .framebuffer     = engine->compositeFrameBuffer};
+    const uint64_t elapsed = (ticks[1] - ticks[0]) & engine->timestampMask;
+    const double   sample  = elapsed * (double)engine->timestampPeriod / rays;
+    if (engine->nsPerRay > 0.0)
+        engine->nsPerRay = 0.75 * engine->nsPerRay + 0.25 * sample;
+    else
+        engine->nsPerRay = sample;
+}
 
-    vkCmdBeginRenderPass(cmdBuf, &rpass, VK_SUBPASS_CONTENTS_INLINE);
+// hands back the batch in flight. only called once the frame fence has 
+// signaled; the frame that traced the batch ends on a host read barrier.
+static void
+collectPicks(Engine* engine)
+{
+    const PickRecord* records = (const PickRecord*)engine->pickRegion.hostData;
+    for (uint32_t i = 0; i < engine->pickFlightCount; i++)
+    {
+        if (records[i].done != engine->pickBatch)
+            return;
+    }
+    // a callback may request more picks, so the batch is retired first
+    const uint32_t count = engine->pickFlightCount;
+    engine->pickFlightCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const PickRecord* r = &records[i];
+        const Dali_Pick pick = {
+            .x      = r->x,
+            .y      = r->y,
+            .hit    = r->hit,
+            .pos    = {r->pos[0], r->pos[1], r->pos[2]},
+            .normal = {r->normal[0], r->normal[1], r->normal[2]},
+            .uv     = {r->uv[0], r->uv[1]},
+            .color  = {r->color[0], r->color[1], r->color[2], r->color[3]}};
+        engine->picksInFlight[i].fn(&pick, engine->picksInFlight[i].data);
+    }
+}
 
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      engine->compPipelines[PIPELINE_COMP_2]);
+// traces the waiting picks against the finished composite, which the 
+// raygen reads through the paint image binding
+static void
+tracePicks(Engine* engine, const VkCommandBuffer cmdBuf)
+{
+    if (engine->pickQueueCount == 0 || engine->pickFlightCount > 0)
+        return;
 
-    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+    engine->pickBatch++;
+    PickRecord* records = (PickRecord*)engine->pickRegion.hostData;
+    for (uint32_t i = 0; i < engine->pickQueueCount; i++)
+    {
+        records[i] = (PickRecord){.x     = engine->pickQueue[i].x,
+                                  .y     = engine->pickQueue[i].y,
+                                  .batch = engine->pickBatch};
+        engine->picksInFlight[i] = engine->pickQueue[i];
+    }
+    engine->pickFlightCount = engine->pickQueueCount;
+    engine->pickQueueCount  = 0;
 
-    vkCmdNextSubpass(cmdBuf, VK_SUBPASS_CONTENTS_INLINE);
+    const VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1};
 
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      engine->compPipelines[PIPELINE_COMP_3]);
+    const VkImageMemoryBarrier toGeneral = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageA.handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT};
 
-    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0,
+                         NULL, 0, NULL, 1, &toGeneral);
 
-    vkCmdNextSubpass(cmdBuf, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                      engine->pickPipeline);
 
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      engine->compPipelines[PIPELINE_COMP_4]);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                            engine->pipelineLayout, 0, 2,
+                            engine->description.descriptorSets, 0, NULL);
 
-    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+    vkCmdTraceRaysKHR(cmdBuf, &engine->pickShaderBindingTable.raygenTable,
+                      &engine->pickShaderBindingTable.missTable,
+                      &engine->pickShaderBindingTable.hitTable,
+                      &engine->pickShaderBindingTable.callableTable,
+                      engine->pickFlightCount, 1, 1);
 
-    vkCmdEndRenderPass(cmdBuf);
+    const VkImageMemoryBarrier toReadOnly = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .image            = engine->imageA.handle,
+        .oldLayout        = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .subresourceRange = range,
+        .srcAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT};
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &toReadOnly);
 }
 
 static VkSemaphore
@@ -1643,12 +4957,28 @@ sync(Engine* engine, const Obdn_Scene* scene, Dali_LayerStack* stack,
     const Obdn_SceneDirtyFlags sceneDirt = obdn_GetSceneDirt(scene);
     if (engine->dirt & DALI_ENGINE_JUST_CREATED_BIT)
     {
+        // what the stack needs to pack its layers
+        stack->width     = engine->textureSize;
+        stack->texelSize = formatInfo(engine)->texelSize;
+        stack->format    = engine->textureFormat;
         updateView(engine, scene);
         updateProj(engine, scene);
         syncBrush(engine, brush);
     }
     if (brush->dirt || sceneDirt || stack->dirt || u->dirt || engine->dirt)
     {
+        if (sceneDirt & OBDN_SCENE_PRIMS_BIT ||
+            engine->dirt & PRIM_DIRTY_BITS ||
+            brush->dirt & BRUSH_PAINT_MODE_BIT ||
+            u->dirt & (UNDO_BIT | UNDO_LAYER_OP_BIT) ||
+            stack->dirt & (LAYER_CHANGED_BIT | LAYER_BACKUP_BIT | LAYER_OPS_BIT))
+            flushDabs(engine);
+        // queued dabs read the camera and brush ubos when they're drawn
+        else if (sceneDirt & (OBDN_SCENE_CAMERA_VIEW_BIT |
+                              OBDN_SCENE_CAMERA_PROJ_BIT) ||
+                 (brush->dirt & BRUSH_GENERAL_BIT &&
+                  dabBrushChanged(engine, brush)))
+            deferFlush(engine);
         if (sceneDirt & OBDN_SCENE_CAMERA_VIEW_BIT)
             updateView(engine, scene);
         if (sceneDirt & OBDN_SCENE_CAMERA_PROJ_BIT)
@@ -1659,26 +4989,65 @@ sync(Engine* engine, const Obdn_Scene* scene, Dali_LayerStack* stack,
             updatePrim(engine, scene);
         if (u->dirt & UNDO_BIT)
         {
+            const Dali_Layer* active = dali_GetLayer(stack, engine->curLayerId);
+            layer_MarkAncestorsStale(stack, active->group);
             if (undo(engine, u))
                 semaphore = engine->cmdAcquireImageTranferSource.semaphore;
         }
+        if (u->dirt & UNDO_LAYER_OP_BIT || stack->dirt & LAYER_OPS_BIT)
+            runLayerOps(engine, stack, u);
         if (stack->dirt & LAYER_CHANGED_BIT)
         {
             onLayerChange(engine, stack,
                           stack->activeLayer); // only one that needs the stack
         }
+        else
+        {
+            // a layer change rebuilds both groups anyway. C ends where the 
+            // live composite starts, and D is overwritten while it runs.
+            const Dali_LayerId liveStart = engine->liveStart;
+            const bool         wasLive   = engine->liveComp;
+            updateLiveComp(engine, stack);
+            if (stack->dirt & LAYER_BACKGROUND_BIT ||
+                engine->liveStart != liveStart)
+                rebuildLayerGroup(engine, stack, true);
+            if (!engine->liveComp &&
+                (stack->dirt & LAYER_FOREGROUND_BIT || wasLive))
+                rebuildLayerGroup(engine, stack, false);
+        }
+        if (stack->dirt & (LAYER_CHANGED_BIT | LAYER_ACTIVE_PROPS_BIT))
+        {
+            const Dali_Layer* active = dali_GetLayer(stack, stack->activeLayer);
+            engine->activeLayerComp = layerComp(engine, active);
+            engine->activeLayerComp.opacity *=
+                layer_PathOpacity(stack, active->group);
+            if (active->isMask)
+                engine->activeLayerComp.mask = 4; // expanded into alpha
+        }
         if (stack->dirt & LAYER_BACKUP_BIT)
         {
             backupLayer(engine, u);
             semaphore = engine->cmdAcquireImageTranferSource.semaphore;
         }
+        if (brush->dirt || stack->dirt & LAYER_CHANGED_BIT)
+            syncCloneSource(engine, stack, brush);
     }
+    buildDeferredAccel(engine);
+    // the active layer lives in B and the clone source is read by the rays;
+    // neither may move
+    Dali_LayerId pinned[2] = {engine->curLayerId};
+    int          pinCount  = 1;
+    if (stack->checkpoint)
+        storeActiveLayer(engine, stack); // B is ahead of its buffer
+    if (engine->snapshotSource.buffer)
+        pinned[pinCount++] = brush->cloneLayer;
+    layer_Rebalance(stack, engine->instance, pinned, pinCount);
     engine->dirt = 0;
     return semaphore;
 }
 
 static void
-updateCommands(Engine* engine, VkCommandBuffer cmdBuf)
+updateCommands(Engine* engine, Dali_LayerStack* stack, VkCommandBuffer cmdBuf)
 {
     VkClearColorValue clearColor = {
         .float32[0] = 0,
@@ -1705,6 +5074,9 @@ updateCommands(Engine* engine, VkCommandBuffer cmdBuf)
         .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
     };
 
+    if (brushSamplesLayer(engine))
+        updateSnapshot(engine, cmdBuf);
+
     vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
                          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
                          &imgBarrier0);
@@ -1726,17 +5098,29 @@ updateCommands(Engine* engine, VkCommandBuffer cmdBuf)
                          VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0,
                          NULL, 0, NULL, 1, &imgBarrier1);
 
+    const uint32_t slot = engine->timestampSlot;
+    readTimestamps(engine, slot);
+    vkCmdResetQueryPool(cmdBuf, engine->timestampPool, 2 * slot, 2);
+    vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        engine->timestampPool, 2 * slot);
+
+    uint32_t rays    = 0;
+    bool     resting = false;
+    if (engine->flushDeferred)
+        drawQueuedDabs(engine, cmdBuf, &rays);
     if (engine->brushActive)
     {
         if (!engine->brushWasActive)
         {
             engine->brushWasActive = true;
             engine->strokeLength = 0.0;
-            vkCmdClearColorImage(cmdBuf, engine->imageA.handle,
-                                 VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1,
-                                 &imageRange);
+            engine->strokeId++;
+            engine->dabCount = 0;
+
+            const Dab dab = nextDab(engine, engine->brushPos, 0.0);
 
-            splat(engine, cmdBuf, engine->brushPos.x, engine->brushPos.y, engine->brushAngle, engine->rayWidth);
+            queueDab(engine, cmdBuf, &dab, &rays);
+            resting = true;
         }
         else 
         {
@@ -1745,7 +5129,8 @@ updateCommands(Engine* engine, VkCommandBuffer cmdBuf)
             const float remainder = fmodf(engine->strokeLength, unit);
             const float totalNewLength = remainder + brushDist;
             engine->strokeLength += brushDist;
-            const int splatCount = (int)(MIN(totalNewLength / unit, 30));
+            resting = brushDist == 0.0;
+            const int splatCount = (int)(MIN(totalNewLength / unit, DAB_QUEUE_SIZE));
             DPRINT("strokeLength %f brushDist %f remainder %f "
                        "totalNewLength %f Splat count: %d\n",
                        engine->strokeLength, brushDist, remainder,
@@ -1763,15 +5148,10 @@ updateCommands(Engine* engine, VkCommandBuffer cmdBuf)
                 float y     = engine->prevBrushPos.y + ystep;
                 t += stepSize;
 
-                vkCmdClearColorImage(cmdBuf, engine->imageA.handle,
-                                     VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1,
-                                     &imageRange);
+                const Dab dab = nextDab(engine, (Vec2){x, y},
+                                        engine->brushAngleVariation);
 
-                float var = M_PI * engine->brushAngleVariation;
-                float angle = engine->brushAngle;
-                splat(engine, cmdBuf, x, y, coal_RandRange(angle - var, angle + var), engine->rayWidth);
-
-                applyPaint(engine, cmdBuf);
+                queueDab(engine, cmdBuf, &dab, &rays);
             }
         }
     }
@@ -1779,9 +5159,20 @@ updateCommands(Engine* engine, VkCommandBuffer cmdBuf)
     {
         engine->brushWasActive = false;
     }
-    applyPaint(engine, cmdBuf);
+    drainDabs(engine, cmdBuf, &rays, resting);
+
+    vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        engine->timestampPool, 2 * slot + 1);
+    engine->timestampRays[slot] = rays;
+    engine->timestampSlot = (slot + 1) % TIMESTAMP_SLOTS;
+
+    comp(engine, stack, cmdBuf);
+
+    previewDab(engine, cmdBuf);
+
+    tracePicks(engine, cmdBuf);
 
-    comp(engine, cmdBuf);
+    hostReadBarrier(cmdBuf);
 }
 
 static void
@@ -1863,6 +5254,33 @@ rayWidthCmd(Hell_Grimoire* grim, void* pengine)
         return;
     }
     engine->rayWidth = rayWidth;
+    selectSamplePattern(engine);
+}
+
+static void 
+progressiveCmd(Hell_Grimoire* grim, void* pengine)
+{
+    Dali_Engine* engine = pengine;
+    int rays = atoi(hell_GetArg(grim, 1));
+    if (rays < 0)
+    {
+        hell_Print("Bad value");
+        return;
+    }
+    engine->progressiveRays = rays;
+}
+
+static void 
+frameBudgetCmd(Hell_Grimoire* grim, void* pengine)
+{
+    Dali_Engine* engine = pengine;
+    float budget = atof(hell_GetArg(grim, 1));
+    if (budget < 0.0)
+    {
+        hell_Print("Bad value");
+        return;
+    }
+    engine->frameBudget = budget;
 }
 
 void
@@ -1884,15 +5302,25 @@ reclaimCmd(Hell_Grimoire* grim, void* engineAndScene)
 VkSemaphore 
 dali_Paint(Dali_Engine* engine, const Obdn_Scene* scene,
            const Dali_Brush* brush, Dali_LayerStack* stack,
-           Dali_UndoManager* um, VkCommandBuffer cmdbuf)
+           Dali_UndoManager* um, VkCommandBuffer cmdbuf, VkFence fence)
 {
+    // everything below writes or reads buffers the last frame used
+    if (engine->frameFence)
+        V_ASSERT(vkWaitForFences(engine->device, 1, &engine->frameFence,
+                                 VK_TRUE, UINT64_MAX));
+    else if (engine->framePending)
+        vkDeviceWaitIdle(engine->device);
+    engine->frameFence   = fence;
+    engine->framePending = true;
     if (engine->state != READY)
     {
         return VK_NULL_HANDLE;
     }
+    // before sync, so picks the callbacks request go out this frame
+    collectPicks(engine);
     VkSemaphore waitSemaphore = sync(engine, scene, stack, brush, um);
     if (engine->activePrim.id == 0) return waitSemaphore;
-    updateCommands(engine, cmdbuf);
+    updateCommands(engine, stack, cmdbuf);
     return waitSemaphore;
 }
 
@@ -1914,7 +5342,8 @@ dali_CreateEngine(const Obdn_Instance* instance, Obdn_Memory* memory,
     assert(texSize > 0);
     assert(texSize % 256 == 0);
 
-    engine->curLayerId = 0;
+    engine->curLayerId    = 0;
+    engine->isolatedGroup = DALI_LAYER_GROUP_NONE;
     engine->graphicsQueueFamilyIndex =
         obdn_GetQueueFamilyIndex(instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
     engine->transferQueueFamilyIndex =
@@ -1935,7 +5364,11 @@ dali_CreateEngine(const Obdn_Instance* instance, Obdn_Memory* memory,
     initRenderPasses(engine);
     initDescSetsAndPipeLayouts(engine);
     initUniformBuffers(engine);
+    initSamplePatterns(engine);
+    initTimestamps(engine);
     initPaintPipelineAndShaderBindingTable(engine);
+    initPickPipeline(engine);
+    initStampPipeline(engine);
     initCompPipelines(engine, DALI_PAINT_MODE_OVER);
 
     initFramebuffers(engine);
@@ -1944,7 +5377,7 @@ dali_CreateEngine(const Obdn_Instance* instance, Obdn_Memory* memory,
 
     createDefaultBrushAlpha(engine);
 
-    updateAllPaintDescriptors(engine, brush);
+    updateAllPaintDescriptors(engine);
     updateDescSetComp(engine);
 
     Obdn_TextureHandle  tex = obdn_SceneAddTexture(scene, &engine->imageA);
@@ -1952,6 +5385,13 @@ dali_CreateEngine(const Obdn_Instance* instance, Obdn_Memory* memory,
         scene, (Vec3){1, 1, 1}, 0.3, tex, NULL_TEXTURE, NULL_TEXTURE);
 
     engine->rayWidth = 512;
+    engine->symmetryCopies = 1;
+    engine->frameBudget = 8.0;
+    engine->activeLayerComp = (CompPushConstants){
+        .blendMode = DALI_BLEND_MODE_NORMAL,
+        .opacity   = 1.0,
+        .coverage  = formatInfos[textureFormat].coverage};
+    selectSamplePattern(engine);
     engine->state = READY;
     engine->dirt |= DALI_ENGINE_JUST_CREATED_BIT;
 
@@ -1962,6 +5402,8 @@ dali_CreateEngine(const Obdn_Instance* instance, Obdn_Memory* memory,
         hell_AddCommand(grimoire, "texsize", printTextureDim, engine);
         hell_AddCommand(grimoire, "savepaint", savePaintCmd, engine);
         hell_AddCommand(grimoire, "raywidth", rayWidthCmd, engine);
+        hell_AddCommand(grimoire, "framebudget", frameBudgetCmd, engine);
+        hell_AddCommand(grimoire, "progressive", progressiveCmd, engine);
         hell_AddCommand2(grimoire, "freeimages", freeImagesCmd, engineAndScene, sizeof(engineAndScene));
         hell_AddCommand2(grimoire, "reclaim", reclaimCmd, engineAndScene, sizeof(engineAndScene));
     }
@@ -1975,9 +5417,16 @@ dali_DestroyEngine(Engine* engine, Obdn_Scene* scene)
     vkDeviceWaitIdle(engine->device);
     obdn_FreeBufferRegion(&engine->matrixRegion);
     obdn_FreeBufferRegion(&engine->brushRegion);
+    obdn_FreeBufferRegion(&engine->dirtyRegion);
+    obdn_FreeBufferRegion(&engine->pickRegion);
+    hell_Free(engine->patternPoints);
+    vkDestroyQueryPool(engine->device, engine->timestampPool, NULL);
     vkDestroyPipeline(engine->device, engine->paintPipeline, NULL);
+    vkDestroyPipeline(engine->device, engine->stampPipeline, NULL);
+    vkDestroyPipeline(engine->device, engine->pickPipeline, NULL);
     vkDestroyPipelineLayout(engine->device, engine->pipelineLayout, NULL);
     obdn_DestroyShaderBindingTable(&engine->shaderBindingTable);
+    obdn_DestroyShaderBindingTable(&engine->pickShaderBindingTable);
     for (int i = 0; i < PIPELINE_COMP_COUNT; i++)
     {
         vkDestroyPipeline(engine->device, engine->compPipelines[i], NULL);
@@ -1995,14 +5444,20 @@ dali_DestroyEngine(Engine* engine, Obdn_Scene* scene)
 
     if (!(engine->state & NEEDS_TO_CREATE_IMAGES))
         dali_EngineDestroyImagesAndDependents(engine, scene);
-    obdn_FreeImage(&engine->defaultBrushAlpha);
+    for (uint32_t i = 0; i < engine->brushTipCount; i++)
+    {
+        obdn_FreeImage(&engine->brushTips[i]);
+        obdn_FreeBufferRegion(&engine->tipSamples[i]);
+    }
 
     vkDestroyRenderPass(engine->device, engine->singleCompositeRenderPass,
                         NULL);
     vkDestroyRenderPass(engine->device, engine->applyPaintRenderPass, NULL);
     vkDestroyRenderPass(engine->device, engine->compositeRenderPass, NULL);
-    obdn_DestroyAccelerationStruct(engine->device, &engine->bottomLevelAS);
-    obdn_DestroyAccelerationStruct(engine->device, &engine->topLevelAS);
+    vkDestroyRenderPass(engine->device, engine->stampRenderPass, NULL);
+    destroyAccelerationStructures(engine);
+    if (engine->triangles.size)
+        obdn_FreeBufferRegion(&engine->triangles);
     memset(engine, 0, sizeof(Engine));
 }
 
@@ -2039,10 +5494,17 @@ dali_EngineDestroyImagesAndDependents(Dali_Engine* engine, Obdn_Scene* scene)
     obdn_FreeImage(&engine->imageB);
     obdn_FreeImage(&engine->imageC);
     obdn_FreeImage(&engine->imageD);
+    obdn_FreeImage(&engine->snapshotImage);
+    obdn_FreeImage(&engine->dabImage);
+    for (int i = 0; i < COMP_BATCH_SIZE; i++)
+        obdn_FreeImage(&engine->compTiles[i]);
+    obdn_FreeBufferRegion(&engine->activeCopy);
+    engine->dabQueueCount = 0; // nothing left to paint them into
     vkDestroyFramebuffer(engine->device, engine->applyPaintFrameBuffer, NULL);
     vkDestroyFramebuffer(engine->device, engine->compositeFrameBuffer, NULL);
     vkDestroyFramebuffer(engine->device, engine->backgroundFrameBuffer, NULL);
     vkDestroyFramebuffer(engine->device, engine->foregroundFrameBuffer, NULL);
+    vkDestroyFramebuffer(engine->device, engine->stampFrameBuffer, NULL);
     obdn_SceneRemoveMaterial(scene, engine->activeMaterial);
     Obdn_Material* mat = obdn_GetMaterial(scene, engine->activeMaterial);
     obdn_SceneRemoveTexture(scene, mat->textureAlbedo);
@@ -2073,4 +5535,50 @@ dali_GetTextureImage(Dali_Engine* e)
 void dali_SetRayWidth(Dali_Engine* engine, u32 width)
 {
     engine->rayWidth = width;
+    selectSamplePattern(engine);
+}
+
+void dali_SetFrameBudget(Dali_Engine* engine, float ms)
+{
+    assert(ms >= 0.0);
+    engine->frameBudget = ms;
+}
+
+void dali_SetProgressiveRays(Dali_Engine* engine, u32 raysPerFrame)
+{
+    engine->progressiveRays = raysPerFrame;
+}
+
+bool
+dali_RequestPick(Dali_Engine* engine, float x, float y, Dali_PickFn fn,
+                 void* data)
+{
+    assert(fn);
+    if (engine->pickQueueCount == DALI_MAX_PICKS)
+        return false;
+    engine->pickQueue[engine->pickQueueCount++] =
+        (PickRequest){.x = x, .y = y, .fn = fn, .data = data};
+    return true;
+}
+
+Dali_BrushTipId
+dali_AddBrushTip(Dali_Engine* engine, const Obdn_Image* alpha)
+{
+    if (engine->brushTipCount == DALI_MAX_BRUSH_TIPS)
+        return DALI_BRUSH_TIP_NONE;
+    const Dali_BrushTipId tip = engine->brushTipCount++;
+    engine->brushTips[tip] = createBrushTip(engine, alpha);
+    compactTipSamples(engine, tip);
+    // adding is a load time operation. switching between loaded tips 
+    // is what has to stay free.
+    vkDeviceWaitIdle(engine->device);
+    updateDescriptorsBrushTip(engine, tip, tip);
+    return tip;
+}
+
+uint32_t
+dali_GetFormatTexelSize(Dali_Format format)
+{
+    assert(format < LEN(formatInfos));
+    return formatInfos[format].texelSize;
 }
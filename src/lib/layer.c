@@ -9,12 +9,73 @@
 
 typedef Dali_Layer   Layer;
 typedef Dali_LayerId LayerId;
+typedef Dali_LayerGroupId LayerGroupId;
+
+// doubles an array of elemSize elements holding count when it's full
+static void*
+reserve(void* array, uint32_t* capacity, uint32_t count, size_t elemSize)
+{
+    if (count < *capacity)
+        return array;
+    const uint32_t newCapacity = *capacity ? *capacity * 2 : 16;
+    void* grown = hell_Malloc(elemSize * newCapacity);
+    if (count)
+        memcpy(grown, array, elemSize * count);
+    hell_Free(array);
+    *capacity = newCapacity;
+    return grown;
+}
+
+static Obdn_BufferRegion
+requestLayerBuffer(Dali_LayerStack* layerStack)
+{
+    return obdn_RequestBufferRegion(layerStack->memory, layerStack->layerSize, 
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+            OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+}
+
+// a clean one from the pool when it has one. recycled spares stay put 
+// until dali_TopUpLayerPool has zeroed them.
+Obdn_BufferRegion
+layer_TakeBuffer(Dali_LayerStack* layerStack)
+{
+    LayerPool* pool = &layerStack->pool;
+    for (int i = 0; i < pool->count; i++)
+    {
+        if (!pool->clean[i])
+            continue;
+        Obdn_BufferRegion buffer = pool->buffers[i];
+        pool->count--;
+        pool->buffers[i] = pool->buffers[pool->count];
+        pool->clean[i]   = pool->clean[pool->count];
+        return buffer;
+    }
+    return requestLayerBuffer(layerStack);
+}
+
+// kept if the pool has room
+void
+layer_GiveBuffer(Dali_LayerStack* layerStack, Obdn_BufferRegion* buffer)
+{
+    LayerPool* pool = &layerStack->pool;
+    if (pool->count == LAYER_POOL_SIZE)
+    {
+        obdn_FreeBufferRegion(buffer);
+        return;
+    }
+    pool->buffers[pool->count] = *buffer;
+    pool->clean[pool->count]   = false;
+    pool->count++;
+}
 
 void dali_CreateLayerStack(Obdn_Memory* memory, const VkDeviceSize textureSize, Dali_LayerStack* layerStack)
 {
     memset(layerStack, 0, sizeof(Dali_LayerStack));
     layerStack->layerSize  = textureSize;
     layerStack->memory = memory;
+    layerStack->hostBudget = VK_WHOLE_SIZE; // everything in host memory
+    layerStack->frameTime  = time(NULL);
+    layerStack->packer.layer = PACK_NO_LAYER;
 
     layerStack->backBuffer  = obdn_RequestBufferRegion(memory, textureSize, 
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
@@ -24,28 +85,79 @@ void dali_CreateLayerStack(Obdn_Memory* memory, const VkDeviceSize textureSize,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
             OBDN_MEMORY_HOST_GRAPHICS_TYPE);
 
+    while (layerStack->pool.count < LAYER_POOL_SIZE)
+        dali_TopUpLayerPool(layerStack);
+
     dali_CreateLayer(layerStack); // create one layer to start
 }
 
+void dali_TopUpLayerPool(Dali_LayerStack* layerStack)
+{
+    LayerPool* pool = &layerStack->pool;
+    for (int i = 0; i < pool->count; i++)
+    {
+        if (!pool->clean[i])
+        {
+            memset(pool->buffers[i].hostData, 0, layerStack->layerSize);
+            pool->clean[i] = true;
+            return;
+        }
+    }
+    if (pool->count < LAYER_POOL_SIZE)
+    {
+        pool->buffers[pool->count] = requestLayerBuffer(layerStack);
+        pool->clean[pool->count]   = true;
+        pool->count++;
+    }
+}
+
 void dali_DestroyLayerStack(Dali_LayerStack* layerStack)
 {
     obdn_FreeBufferRegion(&layerStack->backBuffer);
     obdn_FreeBufferRegion(&layerStack->frontBuffer);
+    for (int i = 0; i < layerStack->pool.count; i++)
+    {
+        obdn_FreeBufferRegion(&layerStack->pool.buffers[i]);
+    }
     for (int i = 0; i < layerStack->layerCount; i++)
     {
-        obdn_FreeBufferRegion(&layerStack->layers[i].bufferRegion);
+        if (!layerStack->layers[i].isMask)
+            layer_ReleasePixels(layerStack, i);
     }
+    layer_CloseSwap(layerStack);
+    if (layerStack->packer.data)
+        hell_Free(layerStack->packer.data);
+    for (int i = 0; i < layerStack->maskSetCount; i++)
+    {
+        if (layerStack->maskSets[i].used)
+            obdn_FreeBufferRegion(&layerStack->maskSets[i].buffer);
+    }
+    for (int i = 0; i < layerStack->groupCount; i++)
+    {
+        obdn_FreeBufferRegion(&layerStack->groups[i].cache);
+    }
+    hell_Free(layerStack->layers);
+    hell_Free(layerStack->maskSets);
     memset(layerStack, 0, sizeof(Dali_LayerStack));
 }
 
 int dali_CreateLayer(Dali_LayerStack* layerStack)
 {
-    assert(layerStack->layerCount < MAX_LAYERS);
+    if (layerStack->layerCount == UINT16_MAX)
+        return -1; // ids are 16 bit
+    layerStack->layers = reserve(layerStack->layers, &layerStack->layerCapacity,
+                                 layerStack->layerCount, sizeof(Layer));
     const uint16_t curId = layerStack->layerCount++;
+    memset(&layerStack->layers[curId], 0, sizeof(Layer));
+    layerStack->layers[curId].lastUse  = layerStack->useClock;
+    layerStack->layers[curId].swapSlot = LAYER_NO_SWAP_SLOT;
+    layerStack->layers[curId].usedAt   = layerStack->frameTime;
 
-    layerStack->layers[curId].bufferRegion = obdn_RequestBufferRegion(layerStack->memory, layerStack->layerSize, 
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-            OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+    layerStack->layers[curId].bufferRegion = layer_TakeBuffer(layerStack);
+    layerStack->layers[curId].opacity   = 1.0;
+    layerStack->layers[curId].visible   = true;
+    layerStack->layers[curId].blendMode = DALI_BLEND_MODE_NORMAL;
+    layerStack->layers[curId].group     = DALI_LAYER_GROUP_NONE;
     
     hell_DebugPrint(PAINT_DEBUG_TAG_LAYER, "Layer created!");
     hell_Print("Adding layer. There are now %d layers. Active layer is %d\n", layerStack->layerCount, layerStack->activeLayer);
@@ -97,8 +209,18 @@ bool dali_DecrementLayer(Dali_LayerStack* layerStack)
 uint8_t* dali_CopyTextureToLayer(Dali_LayerStack* layerStack, const LayerId id, const void* data, uint32_t w, uint32_t h, VkFormat format)
 {
     assert(id < layerStack->layerCount);
-    assert(w == h && w == 4096);
-    const uint64_t size = w * h * 4;
+    assert(w == h);
+    // data is in the stack's format
+    assert(layerStack->layerSize % ((uint64_t)w * h) == 0);
+    const uint64_t size = layerStack->layerSize;
+    layer_MarkAncestorsStale(layerStack, layerStack->layers[id].group);
+    if (layerStack->layers[id].isMask)
+    {
+        // only the alpha is kept
+        layer_PackMask(layerStack, id, data);
+        return layerStack->maskSets[layerStack->layers[id].maskSet].buffer.hostData;
+    }
+    layer_ResetToHost(layerStack, id);
     memcpy(layerStack->layers[id].bufferRegion.hostData, data, size);
     return layerStack->layers[id].bufferRegion.hostData;
 }
@@ -116,4 +238,609 @@ void dali_LayerStackClearDirt(Dali_LayerStack* layerStack)
 void dali_LayerBackup(Dali_LayerStack* layerStack)
 {
     layerStack->dirt |= LAYER_BACKUP_BIT;
+    // the groups holding the active layer are out of date once it's 
+    // painted. they're passed through until another layer is active.
+    layer_MarkAncestorsStale(layerStack,
+                             layerStack->layers[layerStack->activeLayer].group);
+}
+
+static void
+propsChanged(Dali_LayerStack* layerStack, LayerId id)
+{
+    layer_MarkAncestorsStale(layerStack, layerStack->layers[id].group);
+    if (id < layerStack->activeLayer)
+        layerStack->dirt |= LAYER_BACKGROUND_BIT;
+    else if (id > layerStack->activeLayer)
+        layerStack->dirt |= LAYER_FOREGROUND_BIT;
+    else
+        layerStack->dirt |= LAYER_ACTIVE_PROPS_BIT;
+}
+
+void dali_SetLayerOpacity(Dali_LayerStack* layerStack, LayerId id, float opacity)
+{
+    assert(id < layerStack->layerCount);
+    opacity = opacity < 0.0 ? 0.0 : opacity > 1.0 ? 1.0 : opacity;
+    if (layerStack->layers[id].opacity == opacity)
+        return;
+    layerStack->layers[id].opacity = opacity;
+    propsChanged(layerStack, id);
+}
+
+void dali_SetLayerVisible(Dali_LayerStack* layerStack, LayerId id, bool visible)
+{
+    assert(id < layerStack->layerCount);
+    if (layerStack->layers[id].visible == visible)
+        return;
+    layerStack->layers[id].visible = visible;
+    propsChanged(layerStack, id);
+}
+
+void dali_SetLayerBlendMode(Dali_LayerStack* layerStack, LayerId id, Dali_BlendMode mode)
+{
+    assert(id < layerStack->layerCount);
+    if (layerStack->layers[id].blendMode == mode)
+        return;
+    layerStack->layers[id].blendMode = mode;
+    propsChanged(layerStack, id);
+}
+
+float dali_GetLayerOpacity(const Dali_LayerStack* layerStack, LayerId id)
+{
+    assert(id < layerStack->layerCount);
+    return layerStack->layers[id].opacity;
+}
+
+bool dali_GetLayerVisible(const Dali_LayerStack* layerStack, LayerId id)
+{
+    assert(id < layerStack->layerCount);
+    return layerStack->layers[id].visible;
+}
+
+Dali_BlendMode dali_GetLayerBlendMode(const Dali_LayerStack* layerStack, LayerId id)
+{
+    assert(id < layerStack->layerCount);
+    return layerStack->layers[id].blendMode;
+}
+
+bool layer_GroupContains(const Dali_LayerStack* layerStack, LayerGroupId group, LayerId id)
+{
+    for (LayerGroupId g = layerStack->layers[id].group; g != DALI_LAYER_GROUP_NONE;
+         g = layerStack->groups[g].parent)
+    {
+        if (g == group)
+            return true;
+    }
+    return false;
+}
+
+void layer_GroupRange(const Dali_LayerStack* layerStack, LayerGroupId group, LayerId* first, LayerId* end)
+{
+    *first = layerStack->layerCount;
+    *end   = 0;
+    for (LayerId l = 0; l < layerStack->layerCount; l++)
+    {
+        if (layer_GroupContains(layerStack, group, l))
+        {
+            if (l < *first)
+                *first = l;
+            *end   = l + 1;
+        }
+    }
+}
+
+float layer_PathOpacity(const Dali_LayerStack* layerStack, LayerGroupId group)
+{
+    float opacity = 1.0;
+    for (LayerGroupId g = group; g != DALI_LAYER_GROUP_NONE; g = layerStack->groups[g].parent)
+    {
+        const Dali_LayerGroup* lg = &layerStack->groups[g];
+        opacity *= lg->visible ? lg->opacity : 0.0;
+    }
+    return opacity;
+}
+
+void layer_MarkAncestorsStale(Dali_LayerStack* layerStack, LayerGroupId group)
+{
+    for (LayerGroupId g = group; g != DALI_LAYER_GROUP_NONE; g = layerStack->groups[g].parent)
+        layerStack->groups[g].stale = true;
+}
+
+static bool
+groupContainsRange(const Dali_LayerStack* layerStack, LayerGroupId group, LayerId first, LayerId end)
+{
+    LayerId lo, hi;
+    layer_GroupRange(layerStack, group, &lo, &hi);
+    return lo <= first && end <= hi;
+}
+
+LayerGroupId dali_GroupLayers(Dali_LayerStack* layerStack, LayerId first, LayerId end)
+{
+    assert(first < end && end <= layerStack->layerCount);
+    if (layerStack->groupCount == MAX_LAYER_GROUPS)
+        return DALI_LAYER_GROUP_NONE;
+
+    // every existing group must hold the range, sit inside it or miss it
+    LayerGroupId parent = DALI_LAYER_GROUP_NONE;
+    for (LayerGroupId g = 0; g < layerStack->groupCount; g++)
+    {
+        LayerId lo, hi;
+        layer_GroupRange(layerStack, g, &lo, &hi);
+        const bool holds  = lo <= first && end <= hi;
+        const bool inside = first <= lo && hi <= end;
+        if (!holds && !inside && lo < end && first < hi)
+            return DALI_LAYER_GROUP_NONE;
+        // the innermost holder is the one every other holder holds
+        if (holds && !inside &&
+            (parent == DALI_LAYER_GROUP_NONE ||
+             groupContainsRange(layerStack, parent, lo, hi)))
+            parent = g;
+    }
+
+    const LayerGroupId id = layerStack->groupCount++;
+    Dali_LayerGroup* group = &layerStack->groups[id];
+    *group = (Dali_LayerGroup){
+        .cache = obdn_RequestBufferRegion(layerStack->memory, layerStack->layerSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            OBDN_MEMORY_HOST_GRAPHICS_TYPE),
+        .stale     = true,
+        .opacity   = 1.0,
+        .visible   = true,
+        .blendMode = DALI_BLEND_MODE_NORMAL,
+        .parent    = parent};
+
+    // adopt what the parent held in the range
+    for (LayerGroupId g = 0; g < id; g++)
+    {
+        if (layerStack->groups[g].parent == parent)
+        {
+            LayerId lo, hi;
+            layer_GroupRange(layerStack, g, &lo, &hi);
+            if (first <= lo && hi <= end)
+                layerStack->groups[g].parent = id;
+        }
+    }
+    for (LayerId l = first; l < end; l++)
+    {
+        if (layerStack->layers[l].group == parent)
+            layerStack->layers[l].group = id;
+    }
+
+    layer_MarkAncestorsStale(layerStack, parent);
+    layerStack->dirt |= LAYER_BACKGROUND_BIT | LAYER_FOREGROUND_BIT;
+    return id;
+}
+
+LayerGroupId dali_GetLayerGroup(const Dali_LayerStack* layerStack, LayerId id)
+{
+    assert(id < layerStack->layerCount);
+    return layerStack->layers[id].group;
+}
+
+LayerGroupId dali_GetGroupParent(const Dali_LayerStack* layerStack, LayerGroupId group)
+{
+    assert(group < layerStack->groupCount);
+    return layerStack->groups[group].parent;
+}
+
+static void
+groupPropsChanged(Dali_LayerStack* layerStack, LayerGroupId group)
+{
+    // the group's own cache doesn't carry its blend, its parents' do
+    layer_MarkAncestorsStale(layerStack, layerStack->groups[group].parent);
+    if (layer_GroupContains(layerStack, group, layerStack->activeLayer))
+    {
+        // passed through, so it reaches everything on both sides
+        layerStack->dirt |= LAYER_BACKGROUND_BIT | LAYER_FOREGROUND_BIT |
+                            LAYER_ACTIVE_PROPS_BIT;
+        return;
+    }
+    LayerId lo, hi;
+    layer_GroupRange(layerStack, group, &lo, &hi);
+    layerStack->dirt |= hi <= layerStack->activeLayer ? LAYER_BACKGROUND_BIT
+                                                      : LAYER_FOREGROUND_BIT;
+}
+
+void dali_SetGroupOpacity(Dali_LayerStack* layerStack, LayerGroupId group, float opacity)
+{
+    assert(group < layerStack->groupCount);
+    opacity = opacity < 0.0 ? 0.0 : opacity > 1.0 ? 1.0 : opacity;
+    if (layerStack->groups[group].opacity == opacity)
+        return;
+    layerStack->groups[group].opacity = opacity;
+    groupPropsChanged(layerStack, group);
+}
+
+void dali_SetGroupVisible(Dali_LayerStack* layerStack, LayerGroupId group, bool visible)
+{
+    assert(group < layerStack->groupCount);
+    if (layerStack->groups[group].visible == visible)
+        return;
+    layerStack->groups[group].visible = visible;
+    groupPropsChanged(layerStack, group);
+}
+
+void dali_SetGroupBlendMode(Dali_LayerStack* layerStack, LayerGroupId group, Dali_BlendMode mode)
+{
+    assert(group < layerStack->groupCount);
+    if (layerStack->groups[group].blendMode == mode)
+        return;
+    layerStack->groups[group].blendMode = mode;
+    groupPropsChanged(layerStack, group);
+}
+
+int dali_CreateMaskLayer(Dali_LayerStack* layerStack, float r, float g, float b)
+{
+    if (layerStack->layerCount == UINT16_MAX)
+        return -1;
+    // a set packs four 8-bit masks into one rgba8 layer's memory
+    if (layerStack->width == 0 ||
+        layerStack->format != DALI_FORMAT_R8G8B8A8_UNORM)
+        return -1;
+
+    // first free channel, or a new set
+    int set = 0;
+    while (set < layerStack->maskSetCount && layerStack->maskSets[set].used == 0xF)
+        set++;
+    if (set == layerStack->maskSetCount)
+    {
+        layerStack->maskSets = reserve(layerStack->maskSets, &layerStack->maskSetCapacity,
+                                       layerStack->maskSetCount, sizeof(Dali_MaskSet));
+        layerStack->maskSets[set].buffer = layer_TakeBuffer(layerStack);
+        layerStack->maskSets[set].used = 0;
+        layerStack->maskSetCount++;
+    }
+    else if (layerStack->maskSets[set].used == 0)
+    {
+        // emptied by a removal, which gave its memory back
+        layerStack->maskSets[set].buffer = layer_TakeBuffer(layerStack);
+    }
+    Dali_MaskSet* maskSet = &layerStack->maskSets[set];
+    int channel = 0;
+    while (maskSet->used & (1 << channel))
+        channel++;
+    maskSet->used |= 1 << channel;
+
+    // clear the channel
+    uint8_t* texels = maskSet->buffer.hostData;
+    for (VkDeviceSize i = channel; i < layerStack->layerSize; i += 4)
+        texels[i] = 0;
+
+    layerStack->layers = reserve(layerStack->layers, &layerStack->layerCapacity,
+                                 layerStack->layerCount, sizeof(Layer));
+    const LayerId id = layerStack->layerCount++;
+    layerStack->layers[id] = (Layer){
+        .opacity     = 1.0,
+        .visible     = true,
+        .blendMode   = DALI_BLEND_MODE_NORMAL,
+        .group       = DALI_LAYER_GROUP_NONE,
+        .isMask      = true,
+        .maskSet     = set,
+        .maskChannel = channel,
+        .fill        = {r, g, b},
+        .lastUse     = layerStack->useClock};
+
+    hell_Print("Adding mask layer in set %d channel %d. There are now %d layers.\n", set, channel, layerStack->layerCount);
+    return id;
+}
+
+bool dali_IsMaskLayer(const Dali_LayerStack* layerStack, LayerId id)
+{
+    assert(id < layerStack->layerCount);
+    return layerStack->layers[id].isMask;
+}
+
+void dali_SetLayerFill(Dali_LayerStack* layerStack, LayerId id, float r, float g, float b)
+{
+    assert(id < layerStack->layerCount);
+    Layer* layer = &layerStack->layers[id];
+    if (!layer->isMask)
+        return;
+    layer->fill[0] = r;
+    layer->fill[1] = g;
+    layer->fill[2] = b;
+    propsChanged(layerStack, id);
+}
+
+Obdn_BufferRegion* layer_SourceBuffer(Dali_LayerStack* layerStack, LayerId id)
+{
+    Layer* layer = &layerStack->layers[id];
+    return layer->isMask ? &layerStack->maskSets[layer->maskSet].buffer
+                         : layer_Buffer(layerStack, id);
+}
+
+static uint8_t
+unorm8(float f)
+{
+    f = f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f;
+    return f * 255.0 + 0.5;
+}
+
+void layer_ExpandMask(const Dali_LayerStack* layerStack, LayerId id, uint8_t* texels)
+{
+    const Layer* layer = &layerStack->layers[id];
+    assert(layer->isMask);
+    const uint8_t* mask = layerStack->maskSets[layer->maskSet].buffer.hostData;
+    const uint8_t r = unorm8(layer->fill[0]);
+    const uint8_t g = unorm8(layer->fill[1]);
+    const uint8_t b = unorm8(layer->fill[2]);
+    for (VkDeviceSize i = 0; i < layerStack->layerSize; i += 4)
+    {
+        texels[i + 0] = r;
+        texels[i + 1] = g;
+        texels[i + 2] = b;
+        texels[i + 3] = mask[i + layer->maskChannel];
+    }
+}
+
+void layer_PackMask(Dali_LayerStack* layerStack, LayerId id, const uint8_t* texels)
+{
+    const Layer* layer = &layerStack->layers[id];
+    assert(layer->isMask);
+    uint8_t* mask = layerStack->maskSets[layer->maskSet].buffer.hostData;
+    for (VkDeviceSize i = 0; i < layerStack->layerSize; i += 4)
+        mask[i + layer->maskChannel] = texels[i + 3];
+}
+
+void layer_FillMask(Dali_LayerStack* layerStack, LayerId id, uint8_t value)
+{
+    const Layer* layer = &layerStack->layers[id];
+    assert(layer->isMask);
+    uint8_t* mask = layerStack->maskSets[layer->maskSet].buffer.hostData;
+    for (VkDeviceSize i = 0; i < layerStack->layerSize; i += 4)
+        mask[i + layer->maskChannel] = value;
+}
+
+void layer_ReadMask(const Dali_LayerStack* layerStack, LayerId id, uint8_t* coverage)
+{
+    const Layer* layer = &layerStack->layers[id];
+    assert(layer->isMask);
+    const uint8_t* mask = layerStack->maskSets[layer->maskSet].buffer.hostData;
+    for (VkDeviceSize i = 0; i < layerStack->layerSize; i += 4)
+        coverage[i / 4] = mask[i + layer->maskChannel];
+}
+
+void layer_WriteMask(Dali_LayerStack* layerStack, LayerId id, const uint8_t* coverage)
+{
+    const Layer* layer = &layerStack->layers[id];
+    assert(layer->isMask);
+    uint8_t* mask = layerStack->maskSets[layer->maskSet].buffer.hostData;
+    for (VkDeviceSize i = 0; i < layerStack->layerSize; i += 4)
+        mask[i + layer->maskChannel] = coverage[i / 4];
+}
+
+// frees the groups left holding no layers. the last group takes over 
+// each freed one's id.
+static void
+dropEmptyGroups(Dali_LayerStack* layerStack)
+{
+    for (LayerGroupId g = 0; g < layerStack->groupCount;)
+    {
+        LayerId lo, hi;
+        layer_GroupRange(layerStack, g, &lo, &hi);
+        if (lo < hi)
+        {
+            g++;
+            continue;
+        }
+        obdn_FreeBufferRegion(&layerStack->groups[g].cache);
+        for (LayerGroupId c = 0; c < layerStack->groupCount; c++)
+        {
+            if (layerStack->groups[c].parent == g)
+                layerStack->groups[c].parent = layerStack->groups[g].parent;
+        }
+        const LayerGroupId last = --layerStack->groupCount;
+        if (g == last)
+            break;
+        layerStack->groups[g] = layerStack->groups[last];
+        for (LayerGroupId c = 0; c < layerStack->groupCount; c++)
+        {
+            if (layerStack->groups[c].parent == last)
+                layerStack->groups[c].parent = g;
+        }
+        for (LayerId l = 0; l < layerStack->layerCount; l++)
+        {
+            if (layerStack->layers[l].group == last)
+                layerStack->layers[l].group = g;
+        }
+    }
+}
+
+void layer_RemoveLayer(Dali_LayerStack* layerStack, LayerId id)
+{
+    assert(layerStack->layerCount > 1);
+    assert(id < layerStack->layerCount);
+    Layer* layer = &layerStack->layers[id];
+    layer_MarkAncestorsStale(layerStack, layer->group);
+    if (layer->isMask)
+    {
+        // an empty set keeps its slot and gets memory again when reused
+        Dali_MaskSet* set = &layerStack->maskSets[layer->maskSet];
+        set->used &= ~(1 << layer->maskChannel);
+        if (set->used == 0)
+            layer_GiveBuffer(layerStack, &set->buffer);
+    }
+    else
+        layer_ReleasePixels(layerStack, id);
+    memmove(layer, layer + 1, sizeof(Layer) * (layerStack->layerCount - id - 1));
+    layerStack->layerCount--;
+    dropEmptyGroups(layerStack);
+    layerStack->packer.layer = PACK_NO_LAYER; // ids above shifted
+
+    // the one below takes over
+    if (layerStack->activeLayer > id || (layerStack->activeLayer == id && id > 0))
+        layerStack->activeLayer--;
+    layerStack->dirt |= LAYER_CHANGED_BIT;
+    hell_Print("Removed layer %d. There are now %d layers.\n", id, layerStack->layerCount);
+}
+
+void layer_InsertLayer(Dali_LayerStack* layerStack, LayerId id, const Layer* props)
+{
+    assert(id <= layerStack->layerCount);
+    layerStack->layers = reserve(layerStack->layers, &layerStack->layerCapacity,
+                                 layerStack->layerCount, sizeof(Layer));
+    Layer* layer = &layerStack->layers[id];
+    memmove(layer + 1, layer, sizeof(Layer) * (layerStack->layerCount - id));
+    layerStack->layerCount++;
+    *layer = *props;
+    layer->residency  = LAYER_RESIDENT_HOST;
+    layer->swapSlot   = LAYER_NO_SWAP_SLOT;
+    layer->lastUse    = layerStack->useClock;
+    layer->usedAt     = layerStack->frameTime;
+    layer->packed     = NULL;
+    layer->packedSize = 0;
+    if (layer->isMask)
+    {
+        Dali_MaskSet* set = &layerStack->maskSets[layer->maskSet];
+        if (set->used == 0)
+            set->buffer = layer_TakeBuffer(layerStack);
+        set->used |= 1 << layer->maskChannel;
+        memset(&layer->bufferRegion, 0, sizeof(layer->bufferRegion));
+    }
+    else
+        layer->bufferRegion = layer_TakeBuffer(layerStack);
+
+    if (layerStack->activeLayer >= id && layerStack->layerCount > 1)
+        layerStack->activeLayer++;
+    layerStack->packer.layer = PACK_NO_LAYER; // ids above shifted
+    layerStack->dirt |= LAYER_CHANGED_BIT;
+    hell_Print("Put back layer %d. There are now %d layers.\n", id, layerStack->layerCount);
+}
+
+void layer_RestoreGroups(Dali_LayerStack* layerStack, const Dali_LayerGroup* groups,
+                         uint16_t groupCount, const LayerGroupId* layerGroups)
+{
+    for (LayerGroupId g = 0; g < layerStack->groupCount; g++)
+        obdn_FreeBufferRegion(&layerStack->groups[g].cache);
+    layerStack->groupCount = groupCount;
+    for (LayerGroupId g = 0; g < groupCount; g++)
+    {
+        layerStack->groups[g]       = groups[g];
+        layerStack->groups[g].cache = requestLayerBuffer(layerStack);
+        layerStack->groups[g].stale = true;
+    }
+    for (LayerId l = 0; l < layerStack->layerCount; l++)
+        layerStack->layers[l].group = layerGroups[l];
+    layerStack->dirt |= LAYER_CHANGED_BIT;
+}
+
+// the innermost group holding both layers. past either end of the stack 
+// there's none.
+static LayerGroupId
+commonGroup(const Dali_LayerStack* layerStack, int below, int above)
+{
+    if (below < 0 || above >= layerStack->layerCount)
+        return DALI_LAYER_GROUP_NONE;
+    for (LayerGroupId g = layerStack->layers[below].group; g != DALI_LAYER_GROUP_NONE;
+         g = layerStack->groups[g].parent)
+    {
+        if (layer_GroupContains(layerStack, g, above))
+            return g;
+    }
+    return DALI_LAYER_GROUP_NONE;
+}
+
+static bool
+groupWithin(const Dali_LayerStack* layerStack, LayerGroupId group, LayerGroupId outer)
+{
+    for (LayerGroupId g = group; g != DALI_LAYER_GROUP_NONE; g = layerStack->groups[g].parent)
+    {
+        if (g == outer)
+            return true;
+    }
+    return outer == DALI_LAYER_GROUP_NONE;
+}
+
+// the innermost of a moved layer's groups it can stay in at to. the 
+// groups holding both neighbours must hold it too, and one inside those 
+// only fits if it ends at one of them. if none fits, the neighbours' 
+// common group.
+static LayerGroupId
+groupAt(const Dali_LayerStack* layerStack, LayerId to, LayerGroupId group)
+{
+    const LayerGroupId common = commonGroup(layerStack, (int)to - 1, to + 1);
+    for (LayerGroupId g = group; g != DALI_LAYER_GROUP_NONE; g = layerStack->groups[g].parent)
+    {
+        if (g == common)
+            return g;
+        const bool below = to > 0 && layer_GroupContains(layerStack, g, to - 1);
+        const bool above = to + 1 < layerStack->layerCount &&
+                           layer_GroupContains(layerStack, g, to + 1);
+        if ((below || above) && groupWithin(layerStack, g, common))
+            return g;
+    }
+    return common;
+}
+
+void layer_MoveLayer(Dali_LayerStack* layerStack, LayerId from, LayerId to)
+{
+    assert(from < layerStack->layerCount && to < layerStack->layerCount);
+    if (from == to)
+        return;
+    Layer moved = layerStack->layers[from];
+    layer_MarkAncestorsStale(layerStack, moved.group);
+    if (from < to)
+        memmove(&layerStack->layers[from], &layerStack->layers[from + 1], sizeof(Layer) * (to - from));
+    else
+        memmove(&layerStack->layers[to + 1], &layerStack->layers[to], sizeof(Layer) * (from - to));
+    layerStack->layers[to] = moved;
+    layerStack->layers[to].group = groupAt(layerStack, to, moved.group);
+    layer_MarkAncestorsStale(layerStack, layerStack->layers[to].group);
+    dropEmptyGroups(layerStack);
+    layerStack->packer.layer = PACK_NO_LAYER; // ids between shifted
+
+    LayerId* active = &layerStack->activeLayer;
+    if (*active == from)
+        *active = to;
+    else if (from < *active && *active <= to)
+        (*active)--;
+    else if (to <= *active && *active < from)
+        (*active)++;
+    layerStack->dirt |= LAYER_CHANGED_BIT;
+}
+
+static void
+queueLayerOp(Dali_LayerStack* layerStack, LayerOp op)
+{
+    if (layerStack->layerOpCount == MAX_LAYER_OPS)
+    {
+        hell_Print("Too many layer ops queued. Dropping one.\n");
+        return;
+    }
+    layerStack->layerOps[layerStack->layerOpCount++] = op;
+    layerStack->dirt |= LAYER_OPS_BIT;
+}
+
+void dali_ClearLayer(Dali_LayerStack* layerStack)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_CLEAR});
+}
+
+void dali_FillLayer(Dali_LayerStack* layerStack, float r, float g, float b, float a)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_FILL, .color = {r, g, b, a}});
+}
+
+void dali_DuplicateLayer(Dali_LayerStack* layerStack)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_DUPLICATE});
+}
+
+void dali_MergeLayerDown(Dali_LayerStack* layerStack)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_MERGE_DOWN});
+}
+
+void dali_FlattenLayers(Dali_LayerStack* layerStack)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_FLATTEN});
+}
+
+void dali_DeleteLayer(Dali_LayerStack* layerStack)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_DELETE});
+}
+
+void dali_MoveLayer(Dali_LayerStack* layerStack, LayerId to)
+{
+    queueLayerOp(layerStack, (LayerOp){.type = LAYER_OP_MOVE, .to = to});
 }
@@ -0,0 +1,144 @@
+#include "private.h"
+#include <hell/common.h>
+#include <string.h>
+
+// a tile is one mode byte and then either the texel every texel in it
+// equals, or the bytes less the one above (the one to the left on its
+// first row) as runs of zeros and literals. control bytes under 128 are
+// c + 1 zeros, the rest c - 127 literal bytes that follow.
+enum {
+    PACK_CONSTANT,
+    PACK_ROW_DELTA,
+};
+
+#define PACK_TILE_SIZE 64
+
+static uint32_t
+tileSize(uint32_t width)
+{
+    const uint32_t tile = width < PACK_TILE_SIZE ? width : PACK_TILE_SIZE;
+    assert(width % tile == 0);
+    return tile;
+}
+
+uint32_t pack_TileCount(uint32_t width)
+{
+    const uint32_t perRow = width / tileSize(width);
+    return perRow * perRow;
+}
+
+size_t pack_TileBound(uint32_t width, uint32_t texelSize)
+{
+    const size_t tile = tileSize(width);
+    return 1 + 2 * tile * tile * texelSize; // a zero between every literal
+}
+
+size_t pack_Tile(const uint8_t* texels, uint32_t width, uint32_t texelSize,
+                 uint32_t index, uint8_t* out)
+{
+    const uint32_t tile    = tileSize(width);
+    const size_t   row     = (size_t)width * texelSize;
+    const size_t   tileRow = (size_t)tile * texelSize;
+    const uint8_t* origin  = texels + (index / (width / tile)) * tile * row +
+                            (index % (width / tile)) * tileRow;
+
+    bool constant = true;
+    for (uint32_t y = 0; y < tile && constant; y++)
+    {
+        for (size_t b = 0; b < tileRow; b++)
+        {
+            if (origin[y * row + b] != origin[b % texelSize])
+            {
+                constant = false;
+                break;
+            }
+        }
+    }
+    uint8_t* o = out;
+    if (constant)
+    {
+        *o++ = PACK_CONSTANT;
+        memcpy(o, origin, texelSize);
+        return 1 + texelSize;
+    }
+
+    *o++ = PACK_ROW_DELTA;
+    uint32_t zeros = 0;
+    uint8_t* lit   = NULL; // control byte of the literal run being written
+    for (uint32_t y = 0; y < tile; y++)
+    {
+        for (size_t b = 0; b < tileRow; b++)
+        {
+            const uint8_t* p    = origin + y * row + b;
+            const uint8_t  pred = y ? *(p - row) : b >= texelSize ? *(p - texelSize) : 0;
+            const uint8_t  r    = *p - pred;
+            if (r == 0)
+            {
+                lit = NULL;
+                if (++zeros == 128)
+                {
+                    *o++  = 127;
+                    zeros = 0;
+                }
+                continue;
+            }
+            if (zeros)
+            {
+                *o++  = zeros - 1;
+                zeros = 0;
+            }
+            if (!lit || *lit == 255)
+            {
+                lit  = o++;
+                *lit = 127;
+            }
+            (*lit)++;
+            *o++ = r;
+        }
+    }
+    if (zeros)
+        *o++ = zeros - 1;
+    return o - out;
+}
+
+void pack_Unpack(const uint8_t* packed, uint32_t width, uint32_t texelSize,
+                 uint8_t* texels)
+{
+    const uint32_t tile    = tileSize(width);
+    const size_t   row     = (size_t)width * texelSize;
+    const size_t   tileRow = (size_t)tile * texelSize;
+    const uint8_t* in      = packed;
+    for (uint32_t t = 0; t < pack_TileCount(width); t++)
+    {
+        uint8_t* origin = texels + (t / (width / tile)) * tile * row +
+                          (t % (width / tile)) * tileRow;
+        if (*in++ == PACK_CONSTANT)
+        {
+            for (uint32_t y = 0; y < tile; y++)
+            {
+                for (size_t b = 0; b < tileRow; b += texelSize)
+                    memcpy(origin + y * row + b, in, texelSize);
+            }
+            in += texelSize;
+            continue;
+        }
+        uint32_t run     = 0;
+        bool     literal = false;
+        for (uint32_t y = 0; y < tile; y++)
+        {
+            for (size_t b = 0; b < tileRow; b++)
+            {
+                if (run == 0)
+                {
+                    const uint8_t c = *in++;
+                    literal = c >= 128;
+                    run     = literal ? c - 127 : c + 1;
+                }
+                run--;
+                uint8_t*      p    = origin + y * row + b;
+                const uint8_t pred = y ? *(p - row) : b >= texelSize ? *(p - texelSize) : 0;
+                *p = pred + (literal ? *in++ : 0);
+            }
+        }
+    }
+}
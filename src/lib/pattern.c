@@ -0,0 +1,111 @@
+#include "pattern.h"
+#include "rng.h"
+#include <hell/common.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Bridson's algorithm, "Fast Poisson Disk Sampling in Arbitrary Dimensions".
+// the grid holds at most one point per cell since the cell diagonal equals
+// the minimum distance.
+
+#define CANDIDATES 30
+
+typedef struct {
+    float     minDist;
+    float     cellSize;
+    int       side;
+    int32_t*  cells;
+    Coal_Vec2* points;
+} Grid;
+
+static int
+cellCoord(const Grid* g, float v)
+{
+    int c = (int)((v + 1.0f) / g->cellSize);
+    return c < 0 ? 0 : c >= g->side ? g->side - 1 : c;
+}
+
+static bool
+farFromNeighbors(const Grid* g, Coal_Vec2 p)
+{
+    const int cx = cellCoord(g, p.x);
+    const int cy = cellCoord(g, p.y);
+    const float minDist2 = g->minDist * g->minDist;
+    for (int y = cy - 2; y <= cy + 2; y++)
+        for (int x = cx - 2; x <= cx + 2; x++)
+        {
+            if (x < 0 || y < 0 || x >= g->side || y >= g->side)
+                continue;
+            const int32_t i = g->cells[y * g->side + x];
+            if (i < 0)
+                continue;
+            const float dx = g->points[i].x - p.x;
+            const float dy = g->points[i].y - p.y;
+            if (dx * dx + dy * dy < minDist2)
+                return false;
+        }
+    return true;
+}
+
+uint32_t
+pattern_PoissonDisc(uint32_t targetCount, uint32_t seed, Coal_Vec2* out)
+{
+    const uint32_t capacity = PATTERN_CAPACITY(targetCount);
+    // Bridson's sets cover about half the area with discs of radius 
+    // minDist / 2. the unit disc has area pi.
+    Grid g;
+    g.minDist  = sqrtf(4.0f * 0.5f / targetCount);
+    g.cellSize = g.minDist / sqrtf(2.0f);
+    g.side     = (int)ceilf(2.0f / g.cellSize);
+    g.cells    = hell_Malloc(sizeof(int32_t) * g.side * g.side);
+    g.points   = out;
+    memset(g.cells, 0xff, sizeof(int32_t) * g.side * g.side);
+
+    uint32_t* active = hell_Malloc(sizeof(uint32_t) * capacity);
+    uint32_t  activeCount = 0;
+    uint32_t  count = 0;
+    uint32_t  draw = 0;
+
+    out[count] = (Coal_Vec2){0, 0};
+    g.cells[cellCoord(&g, 0) * g.side + cellCoord(&g, 0)] = count;
+    active[activeCount++] = count++;
+
+    while (activeCount > 0 && count < capacity)
+    {
+        const RngState pick = rng_Pcg4d(seed, draw++, 0, 0);
+        const uint32_t a = pick.x % activeCount;
+        const Coal_Vec2 center = out[active[a]];
+        bool found = false;
+        for (int k = 0; k < CANDIDATES; k++)
+        {
+            const RngState r = rng_Pcg4d(seed, draw++, 0, 0);
+            const float angle = 2.0f * M_PI * rng_Float(r.x);
+            const float dist  = g.minDist * (1.0f + rng_Float(r.y));
+            const Coal_Vec2 p = {center.x + dist * cosf(angle),
+                                 center.y + dist * sinf(angle)};
+            if (p.x * p.x + p.y * p.y > 1.0f || !farFromNeighbors(&g, p))
+                continue;
+            out[count] = p;
+            g.cells[cellCoord(&g, p.y) * g.side + cellCoord(&g, p.x)] = count;
+            active[activeCount++] = count++;
+            found = true;
+            break;
+        }
+        if (!found)
+            active[a] = active[--activeCount];
+    }
+
+    for (uint32_t i = count - 1; i > 0; i--)
+    {
+        const RngState r = rng_Pcg4d(seed, i, 1, 0);
+        const uint32_t j = r.x % (i + 1);
+        const Coal_Vec2 p = out[i];
+        out[i] = out[j];
+        out[j] = p;
+    }
+
+    hell_Free(active);
+    hell_Free(g.cells);
+    return count;
+}
@@ -0,0 +1,16 @@
+#ifndef DALI_PATTERN_H
+#define DALI_PATTERN_H
+
+#include <stdint.h>
+#include <coal/coal.h>
+
+// blue noise sample sets over the unit disc. each set is a Poisson disk 
+// with roughly targetCount points; the actual count is returned. points 
+// are written to out, which must hold PATTERN_CAPACITY(targetCount). they 
+// come out shuffled, so any prefix is an even, sparser cover of the disc.
+
+#define PATTERN_CAPACITY(targetCount) ((targetCount) + (targetCount) / 4)
+
+uint32_t pattern_PoissonDisc(uint32_t targetCount, uint32_t seed, Coal_Vec2* out);
+
+#endif /* end of include guard: DALI_PATTERN_H */
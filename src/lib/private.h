@@ -5,43 +5,245 @@
 #include <obsidian/video.h>
 #include "obsidian/memory.h"
 #include "brush.h"
-#define MAX_LAYERS 64
+#include "engine.h"
+#include <time.h>
+#define MAX_LAYER_GROUPS 32
 
 typedef uint32_t DirtMask;
 
-#define PAINT_MODE_OVER  DALI_PAINT_MODE_OVER
-#define PAINT_MODE_ERASE DALI_PAINT_MODE_ERASE
+#define PAINT_MODE_OVER    DALI_PAINT_MODE_OVER
+#define PAINT_MODE_ERASE   DALI_PAINT_MODE_ERASE
+#define PAINT_MODE_SMUDGE  DALI_PAINT_MODE_SMUDGE
+#define PAINT_MODE_BLUR    DALI_PAINT_MODE_BLUR
+#define PAINT_MODE_SHARPEN DALI_PAINT_MODE_SHARPEN
+#define PAINT_MODE_CLONE   DALI_PAINT_MODE_CLONE
 
 typedef enum {
     BRUSH_GENERAL_BIT    = (DirtMask)1 << 1,
     BRUSH_PAINT_MODE_BIT = (DirtMask)1 << 2,
-    BRUSH_ALPHA_BIT      = (DirtMask)1 << 3
 } BrushDirtyBits;
 
 typedef enum {
     LAYER_BACKUP_BIT  = (DirtMask)1 << 4,
     LAYER_CHANGED_BIT = (DirtMask)1 << 5,
+    // a layer property changed below, at or above the active layer. only 
+    // the cached composite holding that layer has to be rebuilt.
+    LAYER_BACKGROUND_BIT  = (DirtMask)1 << 6,
+    LAYER_ACTIVE_PROPS_BIT = (DirtMask)1 << 7,
+    LAYER_FOREGROUND_BIT  = (DirtMask)1 << 8,
+    LAYER_OPS_BIT         = (DirtMask)1 << 9,
 } LayerStackDirtyBits;
 
 typedef enum {
     UNDO_BIT          = (DirtMask)1 << 3,
+    UNDO_LAYER_OP_BIT = (DirtMask)1 << 4,
 } UndoDirtyBits;
 
+// whole-layer edits, queued on the stack and run by the engine
+typedef enum {
+    LAYER_OP_CLEAR,
+    LAYER_OP_FILL,
+    LAYER_OP_DUPLICATE,
+    LAYER_OP_MERGE_DOWN,
+    LAYER_OP_FLATTEN,
+    LAYER_OP_DELETE,
+    LAYER_OP_MOVE,
+} LayerOpType;
+
+typedef struct LayerOp {
+    LayerOpType  type;
+    float        color[4]; // fill
+    Dali_LayerId to;       // move
+} LayerOp;
+
+#define MAX_LAYER_OPS 8
+
+// where a layer's pixels are. the compositor reads them from either 
+// memory; disk layers are read back in from their swap file slot, and 
+// packed ones unpacked from the heap, when they're next used.
+typedef enum {
+    LAYER_RESIDENT_HOST,
+    LAYER_RESIDENT_DEVICE,
+    LAYER_RESIDENT_DISK,
+    LAYER_RESIDENT_PACKED,
+} LayerResidency;
+
 typedef struct Dali_Layer {
     Obdn_BufferRegion bufferRegion;
+    LayerResidency    residency;
+    uint32_t          lastUse;  // frame it was last read
+    uint32_t          swapSlot; // kept once given, LAYER_NO_SWAP_SLOT till then
+    time_t            usedAt;   // wall clock of lastUse
+    uint8_t*          packed;
+    size_t            packedSize;
+    float             opacity;
+    bool              visible;
+    Dali_BlendMode    blendMode;
+    Dali_LayerGroupId group; // innermost group holding it
+    // mask layers own no pixels. their coverage is one channel of a 
+    // shared rgba8 mask set and their color is fill.
+    bool              isMask;
+    uint16_t          maskSet;
+    uint8_t           maskChannel;
+    float             fill[3];
 } Dali_Layer;
 
+// four 8-bit masks packed into the channels of one layer sized buffer
+typedef struct Dali_MaskSet {
+    Obdn_BufferRegion buffer;
+    uint8_t           used; // bit per channel
+} Dali_MaskSet;
+
+// a contiguous run of layers, nested like the runs it holds. cache is 
+// the run flattened with each member's own blend, starting from clear, 
+// with straight color like a layer's.
+typedef struct Dali_LayerGroup {
+    Obdn_BufferRegion cache;
+    bool              stale;
+    float             opacity;
+    bool              visible;
+    Dali_BlendMode    blendMode;
+    Dali_LayerGroupId parent;
+} Dali_LayerGroup;
+
+#define LAYER_NO_SWAP_SLOT UINT32_MAX
+
+// layer sized slots of a file mapped into memory, behind a table of which 
+// slot holds which layer. it's written through the page cache, so what 
+// was swapped out or checkpointed outlives a crash.
+typedef struct SwapFile {
+    intptr_t     file;    // fd, or HANDLE on windows
+    void*        mapping; // windows only
+    uint8_t*     map;
+    VkDeviceSize size;
+    char         path[256];
+} SwapFile;
+
+#define PACK_TILES_PER_FRAME 64
+#define PACK_NO_LAYER        UINT32_MAX
+
+// packs an idle host layer a few tiles a frame. it's dropped if the layer 
+// is used before it's done.
+typedef struct Packer {
+    uint32_t layer;
+    uint32_t lastUse; // the layer's when packing started
+    uint32_t tile;
+    size_t   size;
+    size_t   capacity;
+    uint8_t* data;
+} Packer;
+
+#define LAYER_POOL_SIZE 2
+
+// layer sized buffers kept warm so making a layer doesn't allocate. ones 
+// handed back by removed layers only go out again once the top up has 
+// zeroed them.
+typedef struct LayerPool {
+    uint8_t           count;
+    bool              clean[LAYER_POOL_SIZE];
+    Obdn_BufferRegion buffers[LAYER_POOL_SIZE];
+} LayerPool;
+
 typedef struct Dali_LayerStack{
     uint16_t     layerCount;
     uint16_t     activeLayer;
     VkDeviceSize layerSize;
-    Dali_Layer    layers[MAX_LAYERS];
+    // grown as layers are added. pointers into it don't outlive a create.
+    uint32_t     layerCapacity;
+    Dali_Layer*  layers;
+    uint16_t          groupCount;
+    Dali_LayerGroup   groups[MAX_LAYER_GROUPS];
+    uint16_t          maskSetCount;
+    uint32_t          maskSetCapacity;
+    Dali_MaskSet*     maskSets;
     Obdn_BufferRegion backBuffer;
     Obdn_BufferRegion frontBuffer;
+    LayerPool         pool;
+    // bytes of layer pixels allowed in each memory. the rest go to the 
+    // swap file, least recently used first.
+    VkDeviceSize      deviceBudget;
+    VkDeviceSize      hostBudget;
+    uint32_t          useClock;
+    SwapFile          swap;
+    // a crashed session's swap file that was recovered or declined, so 
+    // it may be written over
+    char              swapReviewed[256];
+    bool              checkpoint; // write every layer to the swap file
+    // layers unused this long are packed. 0 never packs.
+    uint32_t          packIdleSeconds;
+    time_t            frameTime;
+    uint32_t          width;     // texels across, 0 till the engine says
+    uint32_t          texelSize;
+    Dali_Format       format;
+    Packer            packer;
+    uint8_t           layerOpCount;
+    LayerOp           layerOps[MAX_LAYER_OPS];
     Obdn_Memory*        memory;
     DirtMask       dirt;
 } Dali_LayerStack;
 
+bool layer_GroupContains(const Dali_LayerStack*, Dali_LayerGroupId group, Dali_LayerId id);
+// first and one past the last layer under the group
+void layer_GroupRange(const Dali_LayerStack*, Dali_LayerGroupId group, Dali_LayerId* first, Dali_LayerId* end);
+// product of the opacities of group and every group above it, 0 if any is 
+// hidden. 1 for DALI_LAYER_GROUP_NONE.
+float layer_PathOpacity(const Dali_LayerStack*, Dali_LayerGroupId group);
+void  layer_MarkAncestorsStale(Dali_LayerStack*, Dali_LayerGroupId group);
+// the buffer the compositor reads a layer from: its pixels, or its mask 
+// set. NULL as for layer_Buffer.
+Obdn_BufferRegion* layer_SourceBuffer(Dali_LayerStack*, Dali_LayerId id);
+// move a mask layer between its packed channel and rgba8 texels holding 
+// fill and the mask in alpha, the form it's painted in while active
+void  layer_ExpandMask(const Dali_LayerStack*, Dali_LayerId id, uint8_t* texels);
+void  layer_PackMask(Dali_LayerStack*, Dali_LayerId id, const uint8_t* texels);
+// the pixels of a layer that isn't a mask, read back in from the swap 
+// file if it was swapped out. counts as a use. NULL, with the layer left 
+// on disk, if the swap file's mapping was lost.
+Obdn_BufferRegion* layer_Buffer(Dali_LayerStack*, Dali_LayerId id);
+// layer_Buffer for a caller about to overwrite all of it: a layer that 
+// can't be read back starts over in host memory instead
+Obdn_BufferRegion* layer_OverwriteBuffer(Dali_LayerStack*, Dali_LayerId id);
+// gives a layer fresh host memory for the caller to overwrite, dropping 
+// whatever it held and wherever it was
+void  layer_ResetToHost(Dali_LayerStack*, Dali_LayerId id);
+// frees a layer's pixels from whichever tier holds them
+void  layer_ReleasePixels(Dali_LayerStack*, Dali_LayerId id);
+// unmaps the swap file and deletes it
+void  layer_CloseSwap(Dali_LayerStack*);
+
+// lossless codec for square layers, a tile at a time in row-major order
+uint32_t pack_TileCount(uint32_t width);
+// most bytes pack_Tile can write
+size_t   pack_TileBound(uint32_t width, uint32_t texelSize);
+// appends tile index of texels to out. returns the bytes written.
+size_t   pack_Tile(const uint8_t* texels, uint32_t width, uint32_t texelSize, uint32_t index, uint8_t* out);
+void     pack_Unpack(const uint8_t* packed, uint32_t width, uint32_t texelSize, uint8_t* texels);
+// demotes least recently used layers until each tier is within budget 
+// and promotes a recently used one to the device if there's room. pinned 
+// layers stay where they are. the stack's clock ticks once per call.
+void  layer_Rebalance(Dali_LayerStack*, const Obdn_Instance*, const Dali_LayerId* pinned, int pinCount);
+// a zeroed layer sized host buffer, and somewhere to put one back
+Obdn_BufferRegion layer_TakeBuffer(Dali_LayerStack*);
+void  layer_GiveBuffer(Dali_LayerStack*, Obdn_BufferRegion*);
+// sets every texel of a mask layer's channel
+void  layer_FillMask(Dali_LayerStack*, Dali_LayerId id, uint8_t value);
+// copy a mask layer's channel out to or in from a byte per texel
+void  layer_ReadMask(const Dali_LayerStack*, Dali_LayerId id, uint8_t* coverage);
+void  layer_WriteMask(Dali_LayerStack*, Dali_LayerId id, const uint8_t* coverage);
+// frees a layer's memory, or its mask channel, and renumbers the layers 
+// above. groups left empty are freed too, which can renumber groups.
+void  layer_RemoveLayer(Dali_LayerStack*, Dali_LayerId id);
+// puts a layer recorded before its removal back in at id, renumbering 
+// the layers above. it gets zeroed pixels, or its mask channel back. its 
+// group may be gone, so follow with layer_RestoreGroups.
+void  layer_InsertLayer(Dali_LayerStack*, Dali_LayerId id, const Dali_Layer* props);
+// replaces the groups with a recorded table and gives each layer its 
+// recorded group. every cache is new and stale.
+void  layer_RestoreGroups(Dali_LayerStack*, const Dali_LayerGroup* groups, uint16_t groupCount, const Dali_LayerGroupId* layerGroups);
+// takes a layer out and puts it back in at to. it joins the innermost 
+// group around its new neighbours, so every group stays one run.
+void  layer_MoveLayer(Dali_LayerStack*, Dali_LayerId from, Dali_LayerId to);
+
 typedef Dali_PaintMode PaintMode;
 
 typedef struct Dali_Brush {
@@ -58,7 +260,15 @@ typedef struct Dali_Brush {
     float         angle;
     float         angleVariation;
     PaintMode     mode;
-    Obdn_Image*   alphaImg; //non-owning
+    Dali_BrushTipId tip;
+    uint32_t      tipSetSize; // dabs pick randomly from [tip, tip + tipSetSize)
+    Dali_CloneSpace cloneSpace;
+    float         cloneOffsetX;
+    float         cloneOffsetY;
+    Dali_LayerId  cloneLayer;
+    uint32_t      mirrors;
+    Dali_Axis     radialAxis;
+    uint32_t      radialCount;
     DirtMask      dirt;
 } Dali_Brush;
 
@@ -70,6 +280,8 @@ typedef uint16_t Dali_LayerId;
 typedef Obdn_BufferRegion BufferRegion;
 typedef Dali_LayerId L_LayerId;
 
+#define UNDO_NO_LAYER ((L_LayerId)0xFFFF) // ids stop short of this
+
 #ifndef WIN32
 _Static_assert(MAX_UNDOS % 2 == 0, "MAX_UNDOS must be a multiple of 2 for bottom wrap around to work");
 #endif
@@ -80,6 +292,27 @@ typedef struct UndoStack {
     Obdn_BufferRegion  bufferRegions[MAX_UNDOS];
 } UndoStack;
 
+#define MAX_LAYER_OP_UNDOS 8
+
+// what a duplicate, merge or flatten overwrote: layers [first, first + 
+// count) with their properties and texels, a mask layer's channel only, 
+// and the grouping. the top removed of them were taken out of the stack 
+// of layerCount. a duplicate saves nothing; first is the copy, dropped 
+// again on undo.
+typedef struct LayerOpUndo {
+    LayerOpType        type;
+    L_LayerId          first;
+    uint16_t           count;
+    uint16_t           removed;
+    uint16_t           layerCount;
+    L_LayerId          activeLayer;
+    Dali_Layer*        layers;
+    Obdn_BufferRegion* saved;
+    Dali_LayerGroupId* layerGroups; // of every layer
+    uint16_t           groupCount;
+    Dali_LayerGroup    groups[MAX_LAYER_GROUPS];
+} LayerOpUndo;
+
 typedef struct Dali_UndoManager { 
     uint8_t   maxStacks;
     uint8_t   maxUndos;
@@ -88,7 +321,27 @@ typedef struct Dali_UndoManager {
     uint8_t   stackNotUsedCounters[MAX_STACKS];
     L_LayerId layerCache[MAX_STACKS];
     UndoStack undoStacks[MAX_STACKS];
+    // layer ops, oldest at layerOpHead. these are undone separately from 
+    // the per layer stacks.
+    uint8_t      layerOpHead;
+    uint8_t      layerOpCount;
+    LayerOpUndo  layerOps[MAX_LAYER_OP_UNDOS];
+    Obdn_Memory* memory;
     DirtMask  dirt;
 } Dali_UndoManager;
 
+// a new journal entry with layers [first, first + count) of the stack 
+// recorded and room for their texels, dropping the oldest if it's full. 
+// call undo_OnLayerRemoved for layers the op removes before this.
+LayerOpUndo* undo_PushLayerOp(Dali_UndoManager*, const Dali_LayerStack*, LayerOpType, L_LayerId first, uint16_t count);
+// the newest entry, NULL if there's none. it's the caller's to free.
+LayerOpUndo* undo_PopLayerOp(Dali_UndoManager*);
+void         undo_FreeLayerOp(LayerOpUndo*);
+// keep the layer cache on the right layers as ids shift. a removed layer's 
+// stack is forgotten. layer ops that touched the renumbered ids are 
+// dropped from the journal.
+void         undo_OnLayerRemoved(Dali_UndoManager*, L_LayerId id);
+void         undo_OnLayerMoved(Dali_UndoManager*, L_LayerId from, L_LayerId to);
+void         undo_OnLayerInserted(Dali_UndoManager*, L_LayerId id);
+
 #endif /* end of include guard: PRIVATE_H */
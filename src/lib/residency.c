@@ -0,0 +1,675 @@
+#include "layer.h"
+#include "private.h"
+#include "dtags.h"
+#include <obsidian/command.h>
+#include <hell/common.h>
+#include <hell/debug.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+typedef Dali_Layer   Layer;
+typedef Dali_LayerId LayerId;
+
+#ifdef WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+#define SWAP_MAGIC "DALISWP1"
+
+// the swap file starts with this. slots follow at SWAP_SLOTS_OFFSET.
+typedef struct SwapHeader {
+    char     magic[8];
+    uint64_t layerSize;
+    uint32_t layerCount;
+    uint32_t slots[UINT16_MAX]; // of the written out layers, in stack order
+} SwapHeader;
+
+#define SWAP_SLOTS_OFFSET \
+    ((sizeof(SwapHeader) + 0xFFFF) & ~(VkDeviceSize)0xFFFF)
+
+static void
+copyBuffer(const Obdn_Instance* instance, const Obdn_BufferRegion* src,
+           const Obdn_BufferRegion* dst)
+{
+    Obdn_Command cmd = obdn_CreateCommand(instance, OBDN_V_QUEUE_GRAPHICS_TYPE);
+
+    obdn_BeginCommandBuffer(cmd.buffer);
+
+    const VkBufferCopy region = {
+        .srcOffset = src->offset, .dstOffset = dst->offset, .size = src->size};
+    vkCmdCopyBuffer(cmd.buffer, src->buffer, dst->buffer, 1, &region);
+
+    obdn_EndCommandBuffer(cmd.buffer);
+
+    obdn_SubmitAndWait(&cmd, 0);
+
+    obdn_DestroyCommand(cmd);
+}
+
+static bool
+mapSwap(SwapFile* swap, VkDeviceSize size)
+{
+#ifdef WIN32
+    const LARGE_INTEGER end = {.QuadPart = (LONGLONG)size};
+    if (!SetFilePointerEx((HANDLE)swap->file, end, NULL, FILE_BEGIN) ||
+        !SetEndOfFile((HANDLE)swap->file))
+        return false;
+    HANDLE mapping = CreateFileMappingA((HANDLE)swap->file, NULL,
+                                        PAGE_READWRITE, 0, 0, NULL);
+    if (!mapping)
+        return false;
+    void* map = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!map)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    swap->mapping = mapping;
+#else
+    if (ftruncate((int)swap->file, size) != 0)
+        return false;
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     (int)swap->file, 0);
+    if (map == MAP_FAILED)
+        return false;
+#endif
+    swap->map  = map;
+    swap->size = size;
+    return true;
+}
+
+static void
+unmapSwap(SwapFile* swap)
+{
+    if (!swap->map)
+        return;
+#ifdef WIN32
+    UnmapViewOfFile(swap->map);
+    CloseHandle(swap->mapping);
+#else
+    munmap(swap->map, swap->size);
+#endif
+    swap->map = NULL;
+}
+
+// remapped bigger, so pointers into the map don't survive it
+static bool
+growSwap(SwapFile* swap, VkDeviceSize size)
+{
+    const VkDeviceSize oldSize = swap->size;
+    unmapSwap(swap);
+    if (mapSwap(swap, size))
+        return true;
+    if (!mapSwap(swap, oldSize))
+        hell_Print("Lost the swap file mapping\n");
+    return false;
+}
+
+static uint8_t*
+slotData(const Dali_LayerStack* stack, uint32_t slot)
+{
+    return stack->swap.map + SWAP_SLOTS_OFFSET + (VkDeviceSize)slot * stack->layerSize;
+}
+
+static void
+writeSwapTable(Dali_LayerStack* stack)
+{
+    SwapHeader* header = (SwapHeader*)stack->swap.map;
+    header->layerCount = 0;
+    for (LayerId l = 0; l < stack->layerCount; l++)
+    {
+        // a session that never swapped anything out leaves an empty table
+        if (stack->layers[l].isMask ||
+            stack->layers[l].swapSlot == LAYER_NO_SWAP_SLOT)
+            continue;
+        header->slots[header->layerCount++] = stack->layers[l].swapSlot;
+    }
+}
+
+static VkDeviceSize
+tierBytes(const Dali_LayerStack* stack, LayerResidency tier)
+{
+    VkDeviceSize bytes = 0;
+    for (LayerId l = 0; l < stack->layerCount; l++)
+    {
+        if (!stack->layers[l].isMask && stack->layers[l].residency == tier)
+            bytes += stack->layerSize;
+    }
+    return bytes;
+}
+
+static bool
+isPinned(LayerId l, const LayerId* pinned, int pinCount)
+{
+    for (int i = 0; i < pinCount; i++)
+    {
+        if (pinned[i] == l)
+            return true;
+    }
+    return false;
+}
+
+// the least, or most, recently used unpinned layer in a tier. -1 if none.
+static int
+findLayer(const Dali_LayerStack* stack, LayerResidency tier, bool oldest,
+          const LayerId* pinned, int pinCount)
+{
+    int found = -1;
+    for (LayerId l = 0; l < stack->layerCount; l++)
+    {
+        const Layer* layer = &stack->layers[l];
+        if (layer->isMask || layer->residency != tier ||
+            isPinned(l, pinned, pinCount))
+            continue;
+        if (found == -1 ||
+            (oldest ? layer->lastUse < stack->layers[found].lastUse
+                    : layer->lastUse > stack->layers[found].lastUse))
+            found = l;
+    }
+    return found;
+}
+
+static uint32_t
+freeSwapSlot(const Dali_LayerStack* stack)
+{
+    for (uint32_t slot = 0;; slot++)
+    {
+        LayerId l = 0;
+        while (l < stack->layerCount &&
+               (stack->layers[l].isMask || stack->layers[l].swapSlot != slot))
+            l++;
+        if (l == stack->layerCount)
+            return slot;
+    }
+}
+
+// a layer keeps its slot from the first time it's written out till it's
+// removed. false if the file couldn't grow to hold it.
+static bool
+giveSwapSlot(Dali_LayerStack* stack, LayerId id)
+{
+    Layer* layer = &stack->layers[id];
+    if (layer->swapSlot != LAYER_NO_SWAP_SLOT)
+        return true;
+    const uint32_t     slot = freeSwapSlot(stack);
+    const VkDeviceSize end  = SWAP_SLOTS_OFFSET + (slot + 1) * stack->layerSize;
+    if (end > stack->swap.size &&
+        !growSwap(&stack->swap, SWAP_SLOTS_OFFSET + 2 * (slot + 1) * stack->layerSize))
+        return false;
+    layer->swapSlot = slot;
+    return true;
+}
+
+static void
+toHost(Dali_LayerStack* stack, const Obdn_Instance* instance, LayerId id)
+{
+    Layer*            layer = &stack->layers[id];
+    Obdn_BufferRegion host  = layer_TakeBuffer(stack);
+    copyBuffer(instance, &layer->bufferRegion, &host);
+    obdn_FreeBufferRegion(&layer->bufferRegion);
+    layer->bufferRegion = host;
+    layer->residency    = LAYER_RESIDENT_HOST;
+}
+
+static void
+toDevice(Dali_LayerStack* stack, const Obdn_Instance* instance, LayerId id)
+{
+    Layer*            layer  = &stack->layers[id];
+    Obdn_BufferRegion device = obdn_RequestBufferRegion(
+        stack->memory, stack->layerSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        OBDN_MEMORY_DEVICE_TYPE);
+    copyBuffer(instance, &layer->bufferRegion, &device);
+    layer_GiveBuffer(stack, &layer->bufferRegion);
+    layer->bufferRegion = device;
+    layer->residency    = LAYER_RESIDENT_DEVICE;
+}
+
+static bool
+toDisk(Dali_LayerStack* stack, LayerId id)
+{
+    Layer* layer = &stack->layers[id];
+    if (!giveSwapSlot(stack, id))
+    {
+        hell_Print("Could not swap out layer %d. Keeping it in memory.\n", id);
+        return false;
+    }
+    memcpy(slotData(stack, layer->swapSlot), layer->bufferRegion.hostData,
+           stack->layerSize);
+    layer_GiveBuffer(stack, &layer->bufferRegion);
+    memset(&layer->bufferRegion, 0, sizeof(layer->bufferRegion));
+    layer->residency = LAYER_RESIDENT_DISK;
+    return true;
+}
+
+// copies a layer that stays where it is into its slot. device and packed 
+// layers go through a spare host buffer.
+static void
+writeBack(Dali_LayerStack* stack, const Obdn_Instance* instance, LayerId id)
+{
+    Layer* layer = &stack->layers[id];
+    if (layer->residency == LAYER_RESIDENT_DISK || !giveSwapSlot(stack, id))
+        return;
+    if (layer->residency == LAYER_RESIDENT_HOST)
+    {
+        memcpy(slotData(stack, layer->swapSlot), layer->bufferRegion.hostData,
+               stack->layerSize);
+        return;
+    }
+    Obdn_BufferRegion window = layer_TakeBuffer(stack);
+    if (layer->residency == LAYER_RESIDENT_PACKED)
+        pack_Unpack(layer->packed, stack->width, stack->texelSize,
+                    window.hostData);
+    else
+        copyBuffer(instance, &layer->bufferRegion, &window);
+    memcpy(slotData(stack, layer->swapSlot), window.hostData, stack->layerSize);
+    layer_GiveBuffer(stack, &window);
+}
+
+static void
+checkpoint(Dali_LayerStack* stack, const Obdn_Instance* instance)
+{
+    for (LayerId l = 0; l < stack->layerCount; l++)
+    {
+        if (!stack->layers[l].isMask)
+            writeBack(stack, instance, l);
+    }
+    writeSwapTable(stack);
+#ifdef WIN32
+    FlushViewOfFile(stack->swap.map, 0);
+#else
+    msync(stack->swap.map, stack->swap.size, MS_ASYNC);
+#endif
+}
+
+// the least recently used unpinned host layer idle long enough to pack.
+// -1 if none.
+static int
+findIdleLayer(const Dali_LayerStack* stack, const LayerId* pinned, int pinCount)
+{
+    int found = -1;
+    for (LayerId l = 0; l < stack->layerCount; l++)
+    {
+        const Layer* layer = &stack->layers[l];
+        if (layer->isMask || layer->residency != LAYER_RESIDENT_HOST ||
+            isPinned(l, pinned, pinCount) ||
+            stack->frameTime - layer->usedAt < stack->packIdleSeconds)
+            continue;
+        if (found == -1 || layer->lastUse < stack->layers[found].lastUse)
+            found = l;
+    }
+    return found;
+}
+
+// packs PACK_TILES_PER_FRAME more tiles of the layer being packed, or 
+// starts on the idlest one. a layer that doesn't shrink to half isn't 
+// tried again till it's been idle that long once more.
+static void
+packStep(Dali_LayerStack* stack, const LayerId* pinned, int pinCount)
+{
+    Packer* packer = &stack->packer;
+    if (packer->layer != PACK_NO_LAYER)
+    {
+        const Layer* layer = packer->layer < stack->layerCount
+                                 ? &stack->layers[packer->layer]
+                                 : NULL;
+        if (!layer || layer->isMask || layer->residency != LAYER_RESIDENT_HOST ||
+            layer->lastUse != packer->lastUse ||
+            isPinned(packer->layer, pinned, pinCount))
+            packer->layer = PACK_NO_LAYER; // used, moved or gone
+    }
+    if (packer->layer == PACK_NO_LAYER)
+    {
+        const int l = findIdleLayer(stack, pinned, pinCount);
+        if (l == -1)
+            return;
+        packer->layer   = l;
+        packer->lastUse = stack->layers[l].lastUse;
+        packer->tile    = 0;
+        packer->size    = 0;
+    }
+
+    Layer*         layer = &stack->layers[packer->layer];
+    const uint32_t count = pack_TileCount(stack->width);
+    const size_t   bound = pack_TileBound(stack->width, stack->texelSize);
+    for (int i = 0; i < PACK_TILES_PER_FRAME && packer->tile < count; i++)
+    {
+        if (packer->size + bound > packer->capacity)
+        {
+            packer->capacity = packer->capacity * 2 > packer->size + bound
+                                   ? packer->capacity * 2
+                                   : packer->size + bound;
+            packer->data = hell_Realloc(packer->data, packer->capacity);
+        }
+        packer->size += pack_Tile(layer->bufferRegion.hostData, stack->width,
+                                  stack->texelSize, packer->tile++,
+                                  packer->data + packer->size);
+    }
+
+    if (packer->size > stack->layerSize / 2)
+    {
+        layer->usedAt = stack->frameTime;
+        packer->layer = PACK_NO_LAYER;
+        return;
+    }
+    if (packer->tile < count)
+        return;
+
+    layer->packed     = hell_Malloc(packer->size);
+    layer->packedSize = packer->size;
+    memcpy(layer->packed, packer->data, packer->size);
+    layer_GiveBuffer(stack, &layer->bufferRegion);
+    memset(&layer->bufferRegion, 0, sizeof(layer->bufferRegion));
+    layer->residency = LAYER_RESIDENT_PACKED;
+    hell_DebugPrint(PAINT_DEBUG_TAG_LAYER, "Packed layer %d to %zu bytes\n",
+                    packer->layer, packer->size);
+    packer->layer = PACK_NO_LAYER;
+}
+
+Obdn_BufferRegion* layer_Buffer(Dali_LayerStack* stack, LayerId id)
+{
+    assert(id < stack->layerCount);
+    Layer* layer = &stack->layers[id];
+    assert(!layer->isMask);
+    layer->lastUse = stack->useClock;
+    layer->usedAt  = stack->frameTime;
+    if (layer->residency == LAYER_RESIDENT_DISK)
+    {
+        // growSwap lost the mapping. the layer stays on disk.
+        if (!stack->swap.map)
+            return NULL;
+        Obdn_BufferRegion host = layer_TakeBuffer(stack);
+        memcpy(host.hostData, slotData(stack, layer->swapSlot),
+               stack->layerSize);
+        layer->bufferRegion = host;
+        layer->residency    = LAYER_RESIDENT_HOST;
+    }
+    else if (layer->residency == LAYER_RESIDENT_PACKED)
+    {
+        Obdn_BufferRegion host = layer_TakeBuffer(stack);
+        pack_Unpack(layer->packed, stack->width, stack->texelSize,
+                    host.hostData);
+        hell_Free(layer->packed);
+        layer->packed       = NULL;
+        layer->bufferRegion = host;
+        layer->residency    = LAYER_RESIDENT_HOST;
+    }
+    return &layer->bufferRegion;
+}
+
+Obdn_BufferRegion* layer_OverwriteBuffer(Dali_LayerStack* stack, LayerId id)
+{
+    Obdn_BufferRegion* buffer = layer_Buffer(stack, id);
+    if (buffer)
+        return buffer;
+    layer_ResetToHost(stack, id);
+    return &stack->layers[id].bufferRegion;
+}
+
+void layer_ResetToHost(Dali_LayerStack* stack, LayerId id)
+{
+    Layer* layer = &stack->layers[id];
+    layer->lastUse = stack->useClock;
+    layer->usedAt  = stack->frameTime;
+    if (layer->residency == LAYER_RESIDENT_HOST)
+        return;
+    if (layer->residency == LAYER_RESIDENT_DEVICE)
+        obdn_FreeBufferRegion(&layer->bufferRegion);
+    if (layer->residency == LAYER_RESIDENT_PACKED)
+    {
+        hell_Free(layer->packed);
+        layer->packed = NULL;
+    }
+    layer->bufferRegion = layer_TakeBuffer(stack);
+    layer->residency    = LAYER_RESIDENT_HOST;
+}
+
+void layer_ReleasePixels(Dali_LayerStack* stack, LayerId id)
+{
+    Layer* layer = &stack->layers[id];
+    switch (layer->residency)
+    {
+        case LAYER_RESIDENT_HOST:   layer_GiveBuffer(stack, &layer->bufferRegion); break;
+        case LAYER_RESIDENT_DEVICE: obdn_FreeBufferRegion(&layer->bufferRegion); break;
+        case LAYER_RESIDENT_DISK:   break; // the slot is free once nothing names it
+        case LAYER_RESIDENT_PACKED: hell_Free(layer->packed); layer->packed = NULL; break;
+    }
+    memset(&layer->bufferRegion, 0, sizeof(layer->bufferRegion));
+}
+
+void layer_CloseSwap(Dali_LayerStack* stack)
+{
+    SwapFile* swap = &stack->swap;
+    if (!swap->path[0])
+        return;
+    unmapSwap(swap);
+#ifdef WIN32
+    CloseHandle((HANDLE)swap->file);
+#else
+    close((int)swap->file);
+#endif
+    remove(swap->path);
+    memset(swap, 0, sizeof(SwapFile));
+}
+
+void layer_Rebalance(Dali_LayerStack* stack, const Obdn_Instance* instance,
+                     const LayerId* pinned, int pinCount)
+{
+    stack->frameTime = time(NULL);
+
+    int l;
+    while (tierBytes(stack, LAYER_RESIDENT_DEVICE) > stack->deviceBudget &&
+           (l = findLayer(stack, LAYER_RESIDENT_DEVICE, true, pinned, pinCount)) != -1)
+        toHost(stack, instance, l);
+
+    while (stack->swap.map &&
+           tierBytes(stack, LAYER_RESIDENT_HOST) > stack->hostBudget &&
+           (l = findLayer(stack, LAYER_RESIDENT_HOST, true, pinned, pinCount)) != -1)
+    {
+        if (!toDisk(stack, l))
+            break;
+    }
+
+    // one promotion a frame: into free room, or in place of a device layer
+    // used less recently. layers used in the same frame don't trade places.
+    l = findLayer(stack, LAYER_RESIDENT_HOST, false, pinned, pinCount);
+    if (l != -1)
+    {
+        if (tierBytes(stack, LAYER_RESIDENT_DEVICE) + stack->layerSize <=
+            stack->deviceBudget)
+            toDevice(stack, instance, l);
+        else
+        {
+            const int coldest =
+                findLayer(stack, LAYER_RESIDENT_DEVICE, true, pinned, pinCount);
+            if (coldest != -1 &&
+                stack->layers[coldest].lastUse < stack->layers[l].lastUse)
+            {
+                toHost(stack, instance, coldest);
+                toDevice(stack, instance, l);
+            }
+        }
+    }
+
+    if (stack->swap.map)
+    {
+        if (stack->checkpoint)
+            checkpoint(stack, instance);
+        else
+            writeSwapTable(stack); // layers come and go
+    }
+    stack->checkpoint = false;
+
+    if (stack->packIdleSeconds && stack->texelSize)
+        packStep(stack, pinned, pinCount);
+
+    stack->useClock++;
+}
+
+// whether the file is a swap file a crashed session left layers in
+static bool
+holdsLayers(intptr_t file)
+{
+    uint8_t head[offsetof(SwapHeader, slots)];
+#ifdef WIN32
+    DWORD      read = 0;
+    const bool ok   = ReadFile((HANDLE)file, head, sizeof(head), &read, NULL) &&
+                    read == sizeof(head);
+#else
+    const bool ok = pread((int)file, head, sizeof(head), 0) == sizeof(head);
+#endif
+    if (!ok || memcmp(head, SWAP_MAGIC, sizeof(((SwapHeader*)0)->magic)) != 0)
+        return false;
+    uint32_t layerCount;
+    memcpy(&layerCount, head + offsetof(SwapHeader, layerCount), sizeof(layerCount));
+    return layerCount > 0;
+}
+
+bool dali_SetLayerBudget(Dali_LayerStack* stack, VkDeviceSize deviceBytes,
+                         VkDeviceSize hostBytes, const char* swapPath)
+{
+    stack->deviceBudget = deviceBytes;
+    stack->hostBudget   = hostBytes;
+    SwapFile* swap = &stack->swap;
+    if (!swapPath || swap->path[0])
+        return true; // the first swap file stays
+    if (strlen(swapPath) >= sizeof(swap->path))
+    {
+        hell_Print("Swap file path too long\n");
+        return false;
+    }
+#ifdef WIN32
+    HANDLE file = CreateFileA(swapPath, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    const bool opened = file != INVALID_HANDLE_VALUE;
+    swap->file = (intptr_t)file;
+#else
+    // not truncated: it may hold what a crashed session left
+    const int fd = open(swapPath, O_RDWR | O_CREAT, 0644);
+    const bool opened = fd != -1;
+    swap->file = fd;
+#endif
+    if (!opened)
+    {
+        hell_Print("Could not open swap file %s\n", swapPath);
+        return false;
+    }
+    if (strcmp(stack->swapReviewed, swapPath) != 0 && holdsLayers(swap->file))
+    {
+        hell_Print("%s holds layers from another session. Recover or decline "
+                   "them first.\n", swapPath);
+#ifdef WIN32
+        CloseHandle((HANDLE)swap->file);
+#else
+        close((int)swap->file);
+#endif
+        swap->file = 0;
+        return false;
+    }
+    strcpy(swap->path, swapPath);
+    // sized to just the header, dropping any old slots
+    if (!mapSwap(swap, SWAP_SLOTS_OFFSET))
+    {
+        hell_Print("Could not map swap file %s\n", swapPath);
+        layer_CloseSwap(stack);
+        return false;
+    }
+    SwapHeader* header = (SwapHeader*)swap->map;
+    memcpy(header->magic, SWAP_MAGIC, sizeof(header->magic));
+    header->layerSize  = stack->layerSize;
+    header->layerCount = 0;
+    return true;
+}
+
+void dali_SetLayerPacking(Dali_LayerStack* stack, uint32_t idleSeconds)
+{
+    stack->packIdleSeconds = idleSeconds;
+}
+
+void dali_CheckpointLayers(Dali_LayerStack* stack)
+{
+    if (!stack->swap.map)
+    {
+        hell_Print("No swap file to checkpoint to\n");
+        return;
+    }
+    stack->checkpoint = true;
+}
+
+// makes a layer of each written out slot the table names. the first of 
+// them becomes active.
+static int
+readLayers(Dali_LayerStack* stack, FILE* file, const SwapHeader* header)
+{
+    int recovered = 0;
+    for (uint32_t i = 0; i < header->layerCount && i < UINT16_MAX; i++)
+    {
+        const uint32_t slot = header->slots[i];
+        if (slot == LAYER_NO_SWAP_SLOT)
+            continue; // never written out
+        const int id = dali_CreateLayer(stack);
+        if (id == -1)
+            break;
+        Layer* layer = &stack->layers[id];
+        if (fseek64(file, SWAP_SLOTS_OFFSET + (int64_t)slot * stack->layerSize,
+                    SEEK_SET) != 0 ||
+            fread(layer->bufferRegion.hostData, stack->layerSize, 1, file) != 1)
+        {
+            hell_Print("The swap file ends early\n");
+            layer_RemoveLayer(stack, id);
+            break;
+        }
+        if (recovered++ == 0)
+            stack->activeLayer = id;
+    }
+    if (recovered)
+        stack->dirt |= LAYER_CHANGED_BIT;
+    return recovered;
+}
+
+int dali_RecoverLayers(Dali_LayerStack* stack, const char* swapPath)
+{
+    if (stack->swap.path[0] && strcmp(stack->swap.path, swapPath) == 0)
+    {
+        hell_Print("%s is this stack's own swap file\n", swapPath);
+        return -1;
+    }
+    FILE* file = fopen(swapPath, "rb");
+    if (!file)
+    {
+        hell_Print("Could not open swap file %s\n", swapPath);
+        return -1;
+    }
+    SwapHeader* header    = hell_Malloc(sizeof(SwapHeader));
+    int         recovered = -1;
+    if (fread(header, sizeof(SwapHeader), 1, file) != 1 ||
+        memcmp(header->magic, SWAP_MAGIC, sizeof(header->magic)) != 0 ||
+        header->layerSize != stack->layerSize)
+        hell_Print("%s is not a swap file for layers of this size\n", swapPath);
+    else
+    {
+        recovered = readLayers(stack, file, header);
+        hell_Print("Recovered %d layers from %s\n", recovered, swapPath);
+        dali_DeclineRecovery(stack, swapPath); // nothing left to lose
+    }
+    hell_Free(header);
+    fclose(file);
+    return recovered;
+}
+
+void dali_DeclineRecovery(Dali_LayerStack* stack, const char* swapPath)
+{
+    if (strlen(swapPath) >= sizeof(stack->swapReviewed))
+        return; // too long to be a swap file path anyway
+    strcpy(stack->swapReviewed, swapPath);
+}
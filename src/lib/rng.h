@@ -0,0 +1,38 @@
+#ifndef DALI_RNG_H
+#define DALI_RNG_H
+
+#include <stdint.h>
+
+// counter-based generator. keys are (stroke, dab, launch x, launch y) so 
+// any draw can be regenerated without state, and a replayed stroke comes 
+// out the same. the host keys its per dab draws with RNG_HOST_LAUNCH, 
+// which no ray can have. it is plain 32 bit integer math so a glsl port 
+// gives identical numbers.
+//
+// pcg4d from Jarzynski and Olano, "Hash Functions for GPU Rendering".
+
+#define RNG_HOST_LAUNCH UINT32_MAX
+
+typedef struct {
+    uint32_t x, y, z, w;
+} RngState;
+
+static inline RngState
+rng_Pcg4d(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+{
+    RngState v = {x * 1664525u + 1013904223u, y * 1664525u + 1013904223u,
+                  z * 1664525u + 1013904223u, w * 1664525u + 1013904223u};
+    v.x += v.y * v.w; v.y += v.z * v.x; v.z += v.x * v.y; v.w += v.y * v.z;
+    v.x ^= v.x >> 16; v.y ^= v.y >> 16; v.z ^= v.z >> 16; v.w ^= v.w >> 16;
+    v.x += v.y * v.w; v.y += v.z * v.x; v.z += v.x * v.y; v.w += v.y * v.z;
+    return v;
+}
+
+// [0, 1) using the top 24 bits so the value is exact in a float
+static inline float
+rng_Float(uint32_t u)
+{
+    return (float)(u >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif /* end of include guard: DALI_RNG_H */
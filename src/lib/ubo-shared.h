@@ -21,5 +21,103 @@ typedef struct {
     float b;
     float opacity;
     float anti_falloff;
+    uint32_t mode;
+    uint32_t cloneSpace;
+    float    cloneOffsetX;
+    float    cloneOffsetY;
+    uint32_t mirrors;
+    uint32_t radialAxis;
+    uint32_t radialCount;
 } UboBrush;
 
+// one per triangle of the active prim so a hit is a single load. the 
+// normal is octahedral, two snorm16s. uvScale is the uv length per 
+// object space length across the triangle.
+typedef struct {
+    Vec2     uv[3];
+    uint32_t normal;
+    float    uvScale;
+} TriangleRecord;
+
+// texel bounds of everything the raygen has written since the host 
+// last reset it. empty when minX > maxX.
+typedef struct {
+    uint32_t minX;
+    uint32_t minY;
+    uint32_t maxX;
+    uint32_t maxY;
+} DirtyRegion;
+
+// the layer being laid down by a composite pass
+typedef struct {
+    uint32_t blendMode;
+    float    opacity;
+    uint32_t coverage; // nonzero for r32 images
+    uint32_t mask;     // 1 + the channel holding a mask layer's coverage, or 0
+    float    fill[3];  // the mask layer's color
+} CompPushConstants;
+
+// must match COMP_BATCH_SIZE in layer.glsl
+#define COMP_BATCH_SIZE 12
+
+// a CompPushConstants squeezed so a batch fits the push constants
+typedef struct {
+    uint32_t mode; // blend mode | mask << 8 | unorm16 opacity << 16
+    uint32_t fill; // unorm8 rgba
+} CompBatchLayer;
+
+// must match the flags in compbatch.glsl
+#define COMP_BATCH_COVERAGE      0x1 // r32 style images, no color
+#define COMP_BATCH_UNPREMULTIPLY 0x2 // leave the group image straight
+
+// up to COMP_BATCH_SIZE layers laid down over one tile of a group image
+typedef struct {
+    uint32_t       count;
+    uint32_t       flags;
+    uint32_t       tileOrigin[2]; // texels
+    float          tileMin[2];    // uv
+    float          tileMax[2];
+    CompBatchLayer layers[COMP_BATCH_SIZE];
+} CompBatchPushConstants;
+
+
+// one pick ray. the host writes the request, the raygen the rest, copying 
+// batch into done last so the host can tell a finished record from a 
+// stale one.
+typedef struct {
+    float    x;
+    float    y;
+    uint32_t batch;
+    uint32_t done;
+    uint32_t hit;
+    float    pos[3];
+    float    normal[3];
+    float    uv[2];
+    float    color[4];
+} PickRecord;
+
+typedef struct {
+    uint32_t stroke;
+    uint32_t dab;
+    float    brushx;
+    float    brushy;
+    float    angle;
+    uint32_t tip;
+    float    prevx;
+    float    prevy;
+    uint32_t sampleOffset;
+    float    lod;
+    float    spread;
+    uint32_t accumulate; // slices of a resting dab go to dabImage
+} PaintPushConstants;
+
+// a dab stamped straight into uv space on a flat canvas. starts with the 
+// paint push constants so the raygen and the stamp share one range.
+typedef struct {
+    PaintPushConstants dab;
+    float              uvMin[2];
+    float              uvMax[2];
+    float              origin[3]; // canvas pos = origin + u * uv.x + v * uv.y
+    float              u[3];
+    float              v[3];
+} StampPushConstants;
@@ -62,6 +62,7 @@ void dali_CreateUndoManager(Obdn_Memory* memory, const uint32_t size, const uint
     assert(maxUndos_ > 0 && maxUndos_  <= MAX_UNDOS);
     assert(maxUndos_ % 2 == 0);
     memset(undo, 0, sizeof(UndoManager));
+    undo->memory = memory;
     undo->maxStacks = maxStacks_;
     undo->maxUndos = maxUndos_;
     undo->curStackIndex = 0;
@@ -83,6 +84,8 @@ void dali_DestroyUndoManager(UndoManager* undo)
             obdn_FreeBufferRegion(&undo->undoStacks[i].bufferRegions[j]);
         }
     }
+    while (undo->layerOpCount)
+        undo_FreeLayerOp(undo_PopLayerOp(undo));
     memset(undo, 0, sizeof(UndoManager));
 }
 
@@ -148,6 +151,136 @@ void dali_Undo(UndoManager* undo)
     undo->dirt |= UNDO_BIT;
 }
 
+void dali_UndoLayerOp(UndoManager* undo)
+{
+    undo->dirt |= UNDO_LAYER_OP_BIT;
+}
+
+LayerOpUndo* undo_PushLayerOp(UndoManager* undo, const Dali_LayerStack* stack, LayerOpType type, L_LayerId first, uint16_t count)
+{
+    assert(first + count <= stack->layerCount);
+    if (undo->layerOpCount == MAX_LAYER_OP_UNDOS)
+    {
+        undo_FreeLayerOp(&undo->layerOps[undo->layerOpHead]);
+        undo->layerOpHead = (undo->layerOpHead + 1) % MAX_LAYER_OP_UNDOS;
+        undo->layerOpCount--;
+    }
+    LayerOpUndo* op = &undo->layerOps[(undo->layerOpHead + undo->layerOpCount++) % MAX_LAYER_OP_UNDOS];
+    op->type        = type;
+    op->first       = first;
+    op->count       = count;
+    op->removed     = 0;
+    op->layerCount  = stack->layerCount;
+    op->activeLayer = stack->activeLayer;
+    op->groupCount  = stack->groupCount;
+    memcpy(op->groups, stack->groups, sizeof(op->groups));
+    if (count)
+    {
+        op->layers      = hell_Malloc(sizeof(Dali_Layer) * count);
+        op->saved       = hell_Malloc(sizeof(Obdn_BufferRegion) * count);
+        op->layerGroups = hell_Malloc(sizeof(Dali_LayerGroupId) * stack->layerCount);
+        memcpy(op->layers, &stack->layers[first], sizeof(Dali_Layer) * count);
+        for (int l = 0; l < stack->layerCount; l++)
+            op->layerGroups[l] = stack->layers[l].group;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        // a mask's channel is a byte a texel
+        const VkDeviceSize size = op->layers[i].isMask ? stack->layerSize / 4 : stack->layerSize;
+        op->saved[i] = obdn_RequestBufferRegion(undo->memory, size, 
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+                OBDN_MEMORY_HOST_GRAPHICS_TYPE);
+    }
+    return op;
+}
+
+LayerOpUndo* undo_PopLayerOp(UndoManager* undo)
+{
+    if (undo->layerOpCount == 0)
+        return NULL;
+    undo->layerOpCount--;
+    return &undo->layerOps[(undo->layerOpHead + undo->layerOpCount) % MAX_LAYER_OP_UNDOS];
+}
+
+void undo_FreeLayerOp(LayerOpUndo* op)
+{
+    for (int i = 0; i < op->count; i++)
+        obdn_FreeBufferRegion(&op->saved[i]);
+    if (op->count)
+    {
+        hell_Free(op->saved);
+        hell_Free(op->layers);
+        hell_Free(op->layerGroups);
+    }
+    memset(op, 0, sizeof(LayerOpUndo));
+}
+
+// drops the journal entries touching any layer in [lo, hi]
+static void
+dropLayerOps(UndoManager* undo, L_LayerId lo, L_LayerId hi)
+{
+    uint8_t kept = 0;
+    for (int i = 0; i < undo->layerOpCount; i++)
+    {
+        LayerOpUndo* op = &undo->layerOps[(undo->layerOpHead + i) % MAX_LAYER_OP_UNDOS];
+        const int last = op->first + (op->count ? op->count - 1 : 0);
+        if (op->first <= hi && lo <= last)
+        {
+            undo_FreeLayerOp(op);
+            continue;
+        }
+        LayerOpUndo* dst = &undo->layerOps[(undo->layerOpHead + kept++) % MAX_LAYER_OP_UNDOS];
+        if (dst != op)
+        {
+            *dst = *op;
+            memset(op, 0, sizeof(LayerOpUndo));
+        }
+    }
+    undo->layerOpCount = kept;
+}
+
+void undo_OnLayerRemoved(UndoManager* undo, L_LayerId id)
+{
+    for (int i = 0; i < undo->maxStacks; i++)
+    {
+        if (undo->layerCache[i] == id)
+        {
+            undo->layerCache[i] = UNDO_NO_LAYER;
+            undo->undoStacks[i].cur = undo->undoStacks[i].trl;
+        }
+        else if (undo->layerCache[i] != UNDO_NO_LAYER && undo->layerCache[i] > id)
+            undo->layerCache[i]--;
+    }
+    dropLayerOps(undo, id, UNDO_NO_LAYER);
+}
+
+void undo_OnLayerInserted(UndoManager* undo, L_LayerId id)
+{
+    for (int i = 0; i < undo->maxStacks; i++)
+    {
+        if (undo->layerCache[i] != UNDO_NO_LAYER && undo->layerCache[i] >= id)
+            undo->layerCache[i]++;
+    }
+    dropLayerOps(undo, id, UNDO_NO_LAYER);
+}
+
+void undo_OnLayerMoved(UndoManager* undo, L_LayerId from, L_LayerId to)
+{
+    for (int i = 0; i < undo->maxStacks; i++)
+    {
+        L_LayerId* id = &undo->layerCache[i];
+        if (*id == UNDO_NO_LAYER)
+            continue;
+        if (*id == from)
+            *id = to;
+        else if (from < *id && *id <= to)
+            (*id)--;
+        else if (to <= *id && *id < from)
+            (*id)++;
+    }
+    dropLayerOps(undo, from < to ? from : to, from < to ? to : from);
+}
+
 void dali_UndoClearDirt(UndoManager* undo)
 {
     undo->dirt = 0;
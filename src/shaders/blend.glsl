@@ -0,0 +1,73 @@
+// must match Dali_BlendMode
+#define BLEND_MODE_NORMAL     0
+#define BLEND_MODE_MULTIPLY   1
+#define BLEND_MODE_SCREEN     2
+#define BLEND_MODE_OVERLAY    3
+#define BLEND_MODE_ADD        4
+#define BLEND_MODE_SOFT_LIGHT 5
+
+float softLight(const float b, const float s)
+{
+    const float d = b <= 0.25 ? ((16.0 * b - 12.0) * b + 4.0) * b : sqrt(b);
+    return s <= 0.5 ? b - (1.0 - 2.0 * s) * b * (1.0 - b)
+                    : b + (2.0 * s - 1.0) * (d - b);
+}
+
+// lays the layer color s over the composite d with the given mode and 
+// opacity, like the fixed over_no_premul it replaces: s is straight, d 
+// premultiplied. modes follow the W3C compositing spec, mixing towards 
+// plain s where d is transparent. a mask layer, with 1 + the channel 
+// holding its coverage in mask, is expanded into its fill first. coverage 
+// images keep coverage in r and have no color to blend.
+vec4 blend(const vec4 d, vec4 s, const uint mode, const float opacity,
+           const bool coverage, const uint mask, const vec3 fill)
+{
+    if (mask != 0)
+        s = vec4(fill, s[int(mask) - 1]);
+
+    if (coverage)
+    {
+        const float a = s.r * opacity;
+        return vec4(a + d.r * (1.0 - a), 0, 0, 0);
+    }
+
+    const float a  = s.a * opacity;
+    const vec3  cb = d.a > 0.0 ? d.rgb / d.a : vec3(0);
+    const vec3  cs = s.rgb;
+    vec3 b;
+    switch (mode)
+    {
+        case BLEND_MODE_MULTIPLY: b = cs * cb; break;
+        case BLEND_MODE_SCREEN:   b = cs + cb - cs * cb; break;
+        case BLEND_MODE_OVERLAY:
+            b = mix(2.0 * cs * cb, 1.0 - 2.0 * (1.0 - cs) * (1.0 - cb), 
+                    step(0.5, cb));
+            break;
+        case BLEND_MODE_ADD:      b = min(cs + cb, 1.0); break;
+        case BLEND_MODE_SOFT_LIGHT:
+            b = vec3(softLight(cb.r, cs.r), softLight(cb.g, cs.g), 
+                     softLight(cb.b, cs.b));
+            break;
+        default:                  b = cs; break;
+    }
+    const vec3 c = mix(cs, b, d.a);
+    return vec4(c * a + d.rgb * (1.0 - a), a + d.a * (1.0 - a));
+}
+
+#ifndef COMP_BATCH
+// must match CompPushConstants
+layout(push_constant) uniform PC {
+    uint  blendMode;
+    float opacity;
+    uint  coverage;
+    uint  mask;
+    vec3  fill;
+} pc;
+
+// blends with the layer the push constants describe
+vec4 blendLayer(const vec4 d, const vec4 s)
+{
+    return blend(d, s, pc.blendMode, pc.opacity, pc.coverage != 0, pc.mask,
+                 pc.fill);
+}
+#endif
@@ -1,3 +1,18 @@
+// must match DALI_MAX_BRUSH_TIPS in brush.h
+#define MAX_BRUSH_TIPS 16
+
+// must match Dali_PaintMode
+#define PAINT_MODE_OVER    0
+#define PAINT_MODE_ERASE   1
+#define PAINT_MODE_SMUDGE  2
+#define PAINT_MODE_BLUR    3
+#define PAINT_MODE_SHARPEN 4
+#define PAINT_MODE_CLONE   5
+
+// must match Dali_CloneSpace
+#define CLONE_SPACE_SCREEN 0
+#define CLONE_SPACE_UV     1
+
 struct Brush {
     float x;
     float y;
@@ -7,4 +22,11 @@ struct Brush {
     float b;
     float opacity;
     float anti_falloff;
+    uint  mode;
+    uint  cloneSpace;
+    float cloneOffsetX;
+    float cloneOffsetY;
+    uint  mirrors;
+    uint  radialAxis;
+    uint  radialCount;
 };
@@ -6,11 +6,17 @@ vec4 over(const vec4 a, const vec4 b)
     return vec4(color, alpha);
 }
 
-vec2 rotateUV(vec2 uv, float a)
+// takes a point in a tip's unit disc to where it lands in a brush turned 
+// by a. the inverse of rotating the brush into the tip's frame.
+vec2 tipToBrush(vec2 q, float a)
 {
     mat2 R = mat2(cos(a), -sin(a), sin(a), cos(a));
-    uv -= vec2(0.5, 0.5);
-    uv = R * uv;
-    uv += vec2(0.5, 0.5);
-    return uv;
+    return q * R;
+}
+
+// the inverse of tipToBrush
+vec2 brushToTip(vec2 p, float a)
+{
+    mat2 R = mat2(cos(a), -sin(a), sin(a), cos(a));
+    return R * p;
 }
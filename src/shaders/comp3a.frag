@@ -2,14 +2,20 @@
 #extension GL_GOOGLE_include_directive : enable
 
 #include "common.glsl"
+#include "blend.glsl"
 
 layout(location = 0) in  vec2 inUv;
 
 layout(location = 0) out vec4 outColor;
 
-layout (input_attachment_index = 0, set = 2, binding = 2) uniform subpassInput subpass;
+layout (input_attachment_index = 0, set = 2, binding = 1) uniform subpassInput background;
+layout (input_attachment_index = 1, set = 2, binding = 2) uniform subpassInput active;
 
+// the background goes down the way the fixed over used to lay it on the 
+// cleared target, then the active layer blends onto it
 void main()
 {
-    outColor = subpassLoad(subpass);
+    const vec4 c = subpassLoad(background);
+    const vec4 d = pc.coverage != 0 ? c : vec4(c.rgb * c.a, c.a);
+    outColor = blendLayer(d, subpassLoad(active));
 }
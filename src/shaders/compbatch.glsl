@@ -0,0 +1,24 @@
+// must match COMP_BATCH_SIZE in ubo-shared.h
+#define COMP_BATCH_SIZE 12
+
+#define COMP_BATCH
+
+// must match the flags in ubo-shared.h
+#define COMP_BATCH_COVERAGE      0x1
+#define COMP_BATCH_UNPREMULTIPLY 0x2
+
+// must match CompBatchLayer
+struct CompBatchLayer {
+    uint mode; // blend mode | mask << 8 | unorm16 opacity << 16
+    uint fill; // unorm8 rgba
+};
+
+// must match CompBatchPushConstants
+layout(push_constant) uniform PC {
+    uint           count;
+    uint           flags;
+    uint           tileOrigin[2]; // texels
+    float          tileMin[2];    // uv
+    float          tileMax[2];
+    CompBatchLayer layers[COMP_BATCH_SIZE];
+} pc;
@@ -0,0 +1,16 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+
+#include "compbatch.glsl"
+
+const vec2 corners[6] = vec2[](
+    vec2(0, 0), vec2(1, 0), vec2(0, 1),
+    vec2(1, 0), vec2(1, 1), vec2(0, 1));
+
+// covers the tile being composited
+void main()
+{
+    const vec2 uv = mix(vec2(pc.tileMin[0], pc.tileMin[1]), 
+                        vec2(pc.tileMax[0], pc.tileMax[1]), corners[gl_VertexIndex]);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
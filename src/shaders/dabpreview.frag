@@ -0,0 +1,15 @@
+#version 460
+
+// what a resting dab has traced so far, laid over the composite by the 
+// pipeline's blend the way applyPaint lays it over the layer
+
+layout(location = 0) in  vec2 inUv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 9) uniform sampler2D dab;
+
+void main()
+{
+    outColor = texelFetch(dab, ivec2(gl_FragCoord.xy), 0);
+}
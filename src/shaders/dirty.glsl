@@ -0,0 +1,10 @@
+// grows the dirty region to include texel. the includer declares the 
+// dirty buffer. reading first keeps most invocations off the atomics.
+void markDirty(const ivec2 texel)
+{
+    const uvec2 t = uvec2(texel);
+    if (t.x < dirty.minX) atomicMin(dirty.minX, t.x);
+    if (t.y < dirty.minY) atomicMin(dirty.minY, t.y);
+    if (t.x > dirty.maxX) atomicMax(dirty.maxX, t.x);
+    if (t.y > dirty.maxY) atomicMax(dirty.maxY, t.y);
+}
@@ -34,3 +34,10 @@ void fireRay(mat4 viewInv, mat4 projInv, vec2 st /*screen space ray origin*/, ve
             0               // payload (location = 0)
     );
 }
+
+// traces from a point in tlas space rather than from the camera
+void fireRayFrom(vec3 origin, vec3 dir, float tMax)
+{
+    traceRayEXT(topLevelAS, gl_RayFlagsOpaqueEXT, 0xFF, 0, 0, 0,
+            origin, 0.0, dir, tMax, 0);
+}
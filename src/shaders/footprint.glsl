@@ -0,0 +1,83 @@
+// spreads a hit over the texels its ray cone covers, after Akenine-Möller 
+// et al., "Texture Level of Detail Strategies for Real-Time Ray Tracing". 
+// the includer declares image, dabImage, pc, cam and hit and includes 
+// dirty.glsl. 
+// define COVERAGE_IN_RED for images that keep coverage in the red channel.
+
+#define MAX_SPLAT_RADIUS 2.0
+
+#ifdef COVERAGE_IN_RED
+#define COVERAGE(c) (c).r
+#else
+#define COVERAGE(c) (c).a
+#endif
+
+// a resting dab's slices gather in dabImage until its last one
+vec4 loadPaint(const ivec2 texel)
+{
+    if (pc.accumulate != 0)
+        return imageLoad(dabImage, texel);
+    return imageLoad(image, texel);
+}
+
+void storePaint(const ivec2 texel, const vec4 color)
+{
+    if (pc.accumulate != 0)
+        imageStore(dabImage, texel, color);
+    else
+        imageStore(image, texel, color);
+}
+
+// radius in texels of the footprint at hit of a camera ray whose cone 
+// has the given spread. spread is in brush units, which fireRay lays on 
+// the view plane z = -1 next to the brush position projInv has scaled by 
+// tan(fov / 2): a spread there turns a ray on the view axis by that many 
+// radians, and one off it by cosa times less. copies of symmetric dabs 
+// measure from their own hit, which is close enough on the meshes 
+// they're meant for.
+float footprintTexels(const float spread)
+{
+    const vec3  ray  = hit.pos - cam.viewInv[3].xyz;
+    const float dist = length(ray);
+    const vec3  axis = -normalize(cam.viewInv[2].xyz);
+    const float cosa = max(dot(ray / dist, axis), 0.2);
+    const float cosi = max(abs(dot(ray / dist, hit.normal)), 0.2);
+    return spread * cosa * dist / cosi * hit.uvScale * float(imageSize(image).x);
+}
+
+// writes color around hit.uv with a tent falloff in coverage. neither 
+// image format here has atomics, so overlapping rays keep the larger 
+// coverage by reading first; rays landing at once can still race, but 
+// neighbours carry nearly the same value.
+void splatFootprint(const float radius, const vec4 color)
+{
+    const ivec2 size   = imageSize(image);
+    const vec2  center = hit.uv * vec2(size);
+
+    if (radius <= 0.5)
+    {
+        // rays are at least as dense as texels. keeps the larger coverage 
+        // like the disc below, so a dab's rays don't undo each other.
+        const ivec2 texel = clamp(ivec2(center), ivec2(0), size - 1);
+        if (COVERAGE(color) > COVERAGE(loadPaint(texel)))
+            storePaint(texel, color);
+        markDirty(texel);
+        return;
+    }
+
+    const float r  = min(radius, MAX_SPLAT_RADIUS);
+    const ivec2 lo = clamp(ivec2(floor(center - r)), ivec2(0), size - 1);
+    const ivec2 hi = clamp(ivec2(floor(center + r)), ivec2(0), size - 1);
+    for (int y = lo.y; y <= hi.y; y++)
+        for (int x = lo.x; x <= hi.x; x++)
+        {
+            const ivec2 texel = ivec2(x, y);
+            const float w = clamp(r + 0.5 - distance(vec2(texel) + 0.5, center), 0.0, 1.0);
+            vec4 c = color;
+            COVERAGE(c) *= w;
+            if (COVERAGE(c) > COVERAGE(loadPaint(texel)))
+                storePaint(texel, c);
+        }
+    markDirty(lo);
+    markDirty(hi);
+}
@@ -0,0 +1,32 @@
+// composites a batch of layers, each copied into a tile image, into a 
+// cached group image. the group image is both the target and an input so 
+// the blends can read what's under each texel. the composite is 
+// premultiplied; a batch with COMP_BATCH_UNPREMULTIPLY leaves it straight, 
+// the way layers and group caches hold color, so it can be copied out. 
+// the includer defines DST_BINDING.
+
+#include "compbatch.glsl"
+#include "blend.glsl"
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 2, binding = 6) uniform sampler2D layers[COMP_BATCH_SIZE];
+layout(input_attachment_index = 0, set = 2, binding = DST_BINDING) uniform subpassInput dst;
+
+void main()
+{
+    const ivec2 texel = ivec2(gl_FragCoord.xy) - 
+                        ivec2(pc.tileOrigin[0], pc.tileOrigin[1]);
+    const bool coverage = (pc.flags & COMP_BATCH_COVERAGE) != 0;
+    vec4 d = subpassLoad(dst);
+    for (uint i = 0; i < pc.count; i++)
+    {
+        const uint mode = pc.layers[i].mode;
+        d = blend(d, texelFetch(layers[i], texel, 0), mode & 0xFF,
+                  float(mode >> 16) / 65535.0, coverage,
+                  (mode >> 8) & 0xFF, unpackUnorm4x8(pc.layers[i].fill).rgb);
+    }
+    if ((pc.flags & COMP_BATCH_UNPREMULTIPLY) != 0 && !coverage && d.a > 0.0)
+        d.rgb /= d.a;
+    outColor = d;
+}
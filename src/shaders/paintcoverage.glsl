@@ -0,0 +1,84 @@
+// paints coverage into the red channel of a one channel image. the 
+// includer defines IMAGE_FORMAT.
+
+#define COVERAGE_IN_RED
+
+#include "raycommon.glsl"
+#include "common.glsl"
+#include "brush.glsl"
+
+layout(set = 0, binding = 1) uniform accelerationStructureEXT topLevelAS;
+
+layout(set = 1, binding = 0) uniform Camera {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 viewInv;
+    mat4 projInv;
+} cam;
+
+layout(set = 1, binding = 1) uniform Block {
+    Brush brush;
+};
+
+layout(set = 1, binding = 2, IMAGE_FORMAT) uniform image2D image;
+
+layout(set = 1, binding = 3) uniform sampler2D brushTips[MAX_BRUSH_TIPS];
+
+layout(set = 1, binding = 4) uniform sampler2D snapshot;
+
+layout(set = 1, binding = 5) buffer Dirty {
+    uint minX;
+    uint minY;
+    uint maxX;
+    uint maxY;
+} dirty;
+
+layout(set = 1, binding = 6) buffer Samples {
+    vec2 p[];
+} samples[MAX_BRUSH_TIPS];
+
+layout(set = 1, binding = 8, IMAGE_FORMAT) uniform image2D dabImage;
+
+layout(location = 0) rayPayloadEXT hitPayload hit;
+
+layout(push_constant) uniform PC {
+    uint  stroke;
+    uint  dab;
+    float brushx;
+    float brushy;
+    float angle;
+    uint  tip;
+    float prevx;
+    float prevy;
+    uint  sampleOffset;
+    float lod;
+    float spread; // ray footprint radius in the tip's unit disc
+    uint  accumulate; // write to dabImage instead of image
+} pc;
+
+#include "fireray.glsl"
+#include "dirty.glsl"
+#include "symmetry.glsl"
+#include "footprint.glsl"
+
+void main() 
+{
+    // points are in the tip's unit disc with the empty parts already 
+    // culled. turning them by the dab angle places the ray in the brush.
+    const vec2 q = samples[pc.tip].p[pc.sampleOffset + gl_LaunchIDEXT.x];
+    const vec2 tipUV = q * 0.5 + 0.5; // map to 0 to 1
+    vec2 brushPos = vec2(pc.brushx, pc.brushy) * 2.0 - 1.0; // map to -1, 1 range
+    vec2 st = tipToBrush(q, pc.angle) * brush.radius;
+
+    if (!traceSymmetric(gl_LaunchIDEXT.z, st, brushPos))
+        return; // missed, or this copy has no surface to land on
+
+    const float dist = length(st);
+    const float f = brush.anti_falloff;
+    float alpha = (1.0 - smoothstep(f, brush.radius, dist)) * brush.opacity;
+    float imgAlpha = textureLod(brushTips[pc.tip], tipUV, pc.lod).r;
+    vec4 color = vec4(alpha * imgAlpha, 0, 0, 0); //spec states R component is used for r32f format images
+
+    splatFootprint(footprintTexels(pc.spread * brush.radius), color);
+}
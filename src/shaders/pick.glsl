@@ -0,0 +1,81 @@
+// traces one ray per pick record through the brush's screen space and 
+// reads the finished composite at the hit. runs after the composite, 
+// with the paint image in general layout. 
+// define COVERAGE_IN_RED for one channel paint images, and IMAGE_FORMAT 
+// for anything but r32f and rgba8.
+
+#include "raycommon.glsl"
+
+// must match DALI_MAX_PICKS in engine.h
+#define MAX_PICKS 16
+
+layout(set = 0, binding = 1) uniform accelerationStructureEXT topLevelAS;
+
+layout(set = 1, binding = 0) uniform Camera {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 viewInv;
+    mat4 projInv;
+} cam;
+
+#ifndef IMAGE_FORMAT
+#ifdef COVERAGE_IN_RED
+#define IMAGE_FORMAT r32f
+#else
+#define IMAGE_FORMAT rgba8
+#endif
+#endif
+
+layout(set = 1, binding = 2, IMAGE_FORMAT) uniform readonly image2D image;
+
+// must match PickRecord in ubo-shared.h
+struct Pick {
+    float x;
+    float y;
+    uint  batch;
+    uint  done;
+    uint  hit;
+    float pos[3];
+    float normal[3];
+    float uv[2];
+    float color[4];
+};
+
+layout(set = 1, binding = 7) buffer Picks {
+    Pick p[MAX_PICKS];
+} picks;
+
+layout(location = 0) rayPayloadEXT hitPayload hit;
+
+#include "fireray.glsl"
+
+void main()
+{
+    const uint i = gl_LaunchIDEXT.x;
+    const vec2 pos = vec2(picks.p[i].x, picks.p[i].y) * 2.0 - 1.0;
+
+    fireRay(cam.viewInv, cam.projInv, vec2(0), pos);
+
+    // the miss shader zeroes the normal
+    const bool didHit = dot(hit.normal, hit.normal) > 0.0;
+    picks.p[i].hit = didHit ? 1 : 0;
+    if (didHit)
+    {
+        const ivec2 size  = imageSize(image);
+        const ivec2 texel = clamp(ivec2(hit.uv * vec2(size)), ivec2(0), size - 1);
+        const vec4  color = imageLoad(image, texel);
+        for (int c = 0; c < 3; c++)
+        {
+            picks.p[i].pos[c]    = hit.pos[c];
+            picks.p[i].normal[c] = hit.normal[c];
+        }
+        picks.p[i].uv[0] = hit.uv.x;
+        picks.p[i].uv[1] = hit.uv.y;
+        for (int c = 0; c < 4; c++)
+            picks.p[i].color[c] = color[c];
+    }
+
+    memoryBarrierBuffer();
+    picks.p[i].done = picks.p[i].batch;
+}
@@ -1,4 +1,10 @@
+// pos and normal are in the tlas space, which is the prim's object space. 
+// uv is negative and normal zero when the ray missed. uvScale is the uv 
+// length per tlas space length across the hit triangle.
 struct hitPayload {
-    vec2 uv;
+    vec2  uv;
+    vec3  pos;
+    vec3  normal;
+    float uvScale;
 };
 
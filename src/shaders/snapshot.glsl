@@ -0,0 +1,30 @@
+// the layer snapshot stores premultiplied color. these return straight 
+// color so the result can go through the same path as the brush color.
+
+vec4 unpremultiply(const vec4 c)
+{
+    return c.a > 0.0 ? vec4(c.rgb / c.a, c.a) : vec4(0);
+}
+
+vec4 sampleSnapshot(const sampler2D snap, const vec2 uv)
+{
+    const ivec2 size = textureSize(snap, 0);
+    const ivec2 t = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+    return unpremultiply(texelFetch(snap, t, 0));
+}
+
+// 3x3 binomial. averaged premultiplied so transparent texels don't 
+// bleed black into the result.
+vec4 blurSnapshot(const sampler2D snap, const vec2 uv)
+{
+    const ivec2 size = textureSize(snap, 0);
+    const ivec2 t = ivec2(uv * vec2(size));
+    vec4 sum = vec4(0);
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+        {
+            const float w = (2 - abs(x)) * (2 - abs(y));
+            sum += w * texelFetch(snap, clamp(t + ivec2(x, y), ivec2(0), size - 1), 0);
+        }
+    return unpremultiply(sum / 16.0);
+}
@@ -0,0 +1,4 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+
+#include "stamp.glsl"
@@ -0,0 +1,56 @@
+// draws a dab straight into uv space on a flat, affinely mapped prim. 
+// each texel goes back to its point on the plane and is tested against 
+// the brush in the same screen space fireRay shoots from, so a stamp 
+// matches what the raygen would have traced. 
+// define COVERAGE_IN_RED for images that keep coverage in the red channel.
+
+#include "common.glsl"
+#include "brush.glsl"
+#include "stampcommon.glsl"
+
+layout(set = 1, binding = 0) uniform Camera {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 viewInv;
+    mat4 projInv;
+} cam;
+
+layout(set = 1, binding = 1) uniform Block {
+    Brush brush;
+};
+
+layout(set = 1, binding = 3) uniform sampler2D brushTips[MAX_BRUSH_TIPS];
+
+layout(location = 0) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    const vec3 p = vec3(pc.origin[0], pc.origin[1], pc.origin[2]) +
+                   vec3(pc.u[0], pc.u[1], pc.u[2]) * inUV.x +
+                   vec3(pc.v[0], pc.v[1], pc.v[2]) * inUV.y;
+    const vec4 pv = cam.view * vec4(p, 1.0);
+    if (pv.z >= 0.0)
+        discard; // behind the camera
+
+    const vec2 bpos = vec2(pc.brushx, pc.brushy) * 2.0 - 1.0;
+    const vec2 st = pv.xy / -pv.z - 
+                    vec2(cam.projInv[0][0] * bpos.x, cam.projInv[1][1] * bpos.y);
+    const float dist = length(st);
+    if (dist > brush.radius)
+        discard;
+
+    const vec2 q = brushToTip(st / brush.radius, pc.angle);
+    const float f = brush.anti_falloff;
+    float alpha = (1.0 - smoothstep(f, brush.radius, dist)) * brush.opacity;
+    // explicit: the discards above leave no derivatives to pick a level
+    alpha *= textureLod(brushTips[pc.tip], q * 0.5 + 0.5, pc.lod).r;
+
+#ifdef COVERAGE_IN_RED
+    outColor = vec4(alpha, 0, 0, 0);
+#else
+    outColor = vec4(brush.r, brush.g, brush.b, alpha);
+#endif
+}
@@ -0,0 +1,18 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+
+#include "stampcommon.glsl"
+
+layout(location = 0) out vec2 outUV;
+
+const vec2 corners[6] = vec2[](
+    vec2(0, 0), vec2(1, 0), vec2(0, 1),
+    vec2(1, 0), vec2(1, 1), vec2(0, 1));
+
+void main()
+{
+    const vec2 uv = mix(vec2(pc.uvMin[0], pc.uvMin[1]), 
+                        vec2(pc.uvMax[0], pc.uvMax[1]), corners[gl_VertexIndex]);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+    outUV = uv;
+}
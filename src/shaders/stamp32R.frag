@@ -0,0 +1,5 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+
+#define COVERAGE_IN_RED
+#include "stamp.glsl"
@@ -0,0 +1,21 @@
+// must match StampPushConstants. the first block is PaintPushConstants; 
+// vectors are split into floats to keep the host's packing.
+layout(push_constant) uniform PC {
+    uint  stroke;
+    uint  dab;
+    float brushx;
+    float brushy;
+    float angle;
+    uint  tip;
+    float prevx;
+    float prevy;
+    uint  sampleOffset;
+    float lod;
+    float spread;
+    uint  accumulate;
+    float uvMin[2]; // texels the dab can reach
+    float uvMax[2];
+    float origin[3]; // the canvas plane: p(uv) = origin + u * uv.x + v * uv.y
+    float u[3];
+    float v[3];
+} pc;
@@ -0,0 +1,49 @@
+// symmetry copies of a dab. the includer declares brush, cam and hit and 
+// includes fireray.glsl first. copy 0 is the dab itself; the others are 
+// every combination of the radial steps and the chosen mirrors.
+
+vec3 applySymmetry(const uint copy, vec3 v)
+{
+    const uint r = copy % brush.radialCount;
+    uint       m = copy / brush.radialCount;
+
+    const float a = 6.28318531 * float(r) / float(brush.radialCount);
+    const float c = cos(a);
+    const float s = sin(a);
+    if (brush.radialAxis == 0)
+        v = vec3(v.x, c * v.y - s * v.z, s * v.y + c * v.z);
+    else if (brush.radialAxis == 1)
+        v = vec3(c * v.x + s * v.z, v.y, c * v.z - s * v.x);
+    else
+        v = vec3(c * v.x - s * v.y, s * v.x + c * v.y, v.z);
+
+    // each set mirror bit takes the next bit of m
+    for (uint axis = 0; axis < 3; axis++)
+    {
+        if ((brush.mirrors & (1u << axis)) == 0)
+            continue;
+        if ((m & 1u) != 0)
+            v[axis] = -v[axis];
+        m >>= 1;
+    }
+    return v;
+}
+
+// finds the surface point this copy paints for a screen space ray. copies 
+// transform the dab's hit and shoot back at the surface along the 
+// transformed normal, so they land wherever the mesh is symmetric. returns 
+// false on a miss.
+bool traceSymmetric(const uint copy, const vec2 st, const vec2 bpos)
+{
+    fireRay(cam.viewInv, cam.projInv, st, bpos);
+    if (copy == 0 || hit.uv.x < 0.0)
+        return hit.uv.x >= 0.0;
+
+    const vec3  p = applySymmetry(copy, hit.pos);
+    const vec3  n = applySymmetry(copy, hit.normal);
+    // tolerance for meshes that are only symmetric up to tessellation
+    const float offset = 0.01 * length(hit.pos - cam.viewInv[3].xyz);
+
+    fireRayFrom(p + n * offset, -n, 2.0 * offset);
+    return hit.uv.x >= 0.0;
+}